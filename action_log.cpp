@@ -0,0 +1,165 @@
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include <physfs.h>
+
+#include "sam_shared.hpp"
+#include "action_log.hpp"
+
+// File layout, all integers little-endian:
+//   "SAML"                      magic
+//   uint16 version              FILE_VERSION
+//   uint16 ticks per second     the log is meaningless at any other tick rate
+//   uint32 seed
+//   uint32 run count
+//   run count * { uint8 actions, uint16 ticks }
+static const char ACTION_LOG_MAGIC[4] = { 'S', 'A', 'M', 'L' };
+
+TActionLog::TActionLog() :
+        m_seed(0),
+        m_ticks(0),
+        m_playbackRun(0),
+        m_playbackTick(0)
+{
+}
+
+void TActionLog::Clear(unsigned int seed)
+{
+    m_runs.clear();
+    m_seed = seed;
+    m_ticks = 0;
+
+    Rewind();
+}
+
+void TActionLog::Record(TActionSet actions)
+{
+    // extend the current run if nothing changed (and it still fits)
+    if (!m_runs.empty() && (m_runs.back().actions == actions) && (m_runs.back().ticks != 0xFFFF))
+        ++m_runs.back().ticks;
+    else
+    {
+        TRun run;
+
+        run.actions = actions;
+        run.ticks = 1;
+        m_runs.push_back(run);
+    }
+
+    ++m_ticks;
+}
+
+void TActionLog::Rewind()
+{
+    m_playbackRun = 0;
+    m_playbackTick = 0;
+}
+
+bool TActionLog::Playback(TActionSet &actions)
+{
+    if (m_playbackRun >= m_runs.size())
+        return false;
+
+    actions = m_runs[m_playbackRun].actions;
+
+    if (++m_playbackTick == m_runs[m_playbackRun].ticks)
+    {
+        ++m_playbackRun;
+        m_playbackTick = 0;
+    }
+
+    return true;
+}
+
+bool TActionLog::Save(const char *filename) const
+{
+    PHYSFS_File *file = PHYSFS_openWrite(filename);
+    bool ok;
+
+    if (file == NULL)
+    {
+        fprintf(stderr, "\nERROR: unable to create action log '%s'. Specifically:\n\t'%s'",
+                        filename, PHYSFS_getLastError());
+        return false;
+    }
+
+    ok = (PHYSFS_write(file, ACTION_LOG_MAGIC, sizeof(ACTION_LOG_MAGIC), 1) == 1) &&
+         PHYSFS_writeULE16(file, FILE_VERSION) &&
+         PHYSFS_writeULE16(file, SIMULATION_TICKS_PER_SECOND) &&
+         PHYSFS_writeULE32(file, m_seed) &&
+         PHYSFS_writeULE32(file, m_runs.size());
+
+    for (std::vector<TRun>::const_iterator it = m_runs.begin(); ok && (it != m_runs.end()); ++it)
+    {
+        ok = (PHYSFS_write(file, &it->actions, sizeof(it->actions), 1) == 1) &&
+             PHYSFS_writeULE16(file, it->ticks);
+    }
+
+    if (!ok)
+        fprintf(stderr, "\nERROR: unable to write action log '%s'. Specifically:\n\t'%s'",
+                        filename, PHYSFS_getLastError());
+
+    PHYSFS_close(file);
+
+    return ok;
+}
+
+bool TActionLog::Load(const char *filename)
+{
+    PHYSFS_File *file = PHYSFS_openRead(filename);
+    char magic[sizeof(ACTION_LOG_MAGIC)];
+    PHYSFS_uint16 version, ticksPerSecond, ticks;
+    PHYSFS_uint32 seed, runCount;
+    TRun run;
+
+    if (file == NULL)
+    {
+        fprintf(stderr, "\nERROR: unable to open action log '%s'. Specifically:\n\t'%s'",
+                        filename, PHYSFS_getLastError());
+        return false;
+    }
+
+    if ((PHYSFS_read(file, magic, sizeof(magic), 1) != 1) ||
+        (memcmp(magic, ACTION_LOG_MAGIC, sizeof(magic)) != 0) ||
+        !PHYSFS_readULE16(file, &version) ||
+        !PHYSFS_readULE16(file, &ticksPerSecond) ||
+        !PHYSFS_readULE32(file, &seed) ||
+        !PHYSFS_readULE32(file, &runCount))
+    {
+        fprintf(stderr, "\nERROR: '%s' is not an action log", filename);
+        PHYSFS_close(file);
+        return false;
+    }
+
+    if ((version != FILE_VERSION) || (ticksPerSecond != SIMULATION_TICKS_PER_SECOND))
+    {
+        fprintf(stderr, "\nERROR: action log '%s' is version %u at %u ticks per second, expected version %u at %d",
+                        filename, version, ticksPerSecond, FILE_VERSION, SIMULATION_TICKS_PER_SECOND);
+        PHYSFS_close(file);
+        return false;
+    }
+
+    Clear(seed);
+
+    for (PHYSFS_uint32 i = 0; i < runCount; ++i)
+    {
+        if ((PHYSFS_read(file, &run.actions, sizeof(run.actions), 1) != 1) ||
+            !PHYSFS_readULE16(file, &ticks) ||
+            (ticks == 0))
+        {
+            fprintf(stderr, "\nERROR: action log '%s' is truncated or corrupt", filename);
+            PHYSFS_close(file);
+            Clear(0);
+            return false;
+        }
+
+        run.ticks = ticks;
+        m_runs.push_back(run);
+        m_ticks += ticks;
+    }
+
+    PHYSFS_close(file);
+
+    return true;
+}
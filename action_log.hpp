@@ -0,0 +1,56 @@
+#ifndef _ACTION_LOG_HPP_
+#define _ACTION_LOG_HPP_
+
+#include <vector>
+
+#include "sam_shared.hpp"
+
+// The actions the player wanted on every simulation tick, plus the random seed the game was started with.
+// Since the simulation only ever advances in fixed ticks, feeding the same log back in reproduces the
+// same game exactly, which makes recorded sessions usable as repeatable workloads.
+//
+// Actions are stored as runs of identical ticks, since keys tend to be held for many ticks at a time.
+class TActionLog
+{
+public:
+    TActionLog();
+
+    // forget everything and start a new log for a game seeded with seed
+    void Clear(unsigned int seed);
+
+    unsigned int Seed() const { return m_seed; };
+    unsigned long Ticks() const { return m_ticks; };
+
+    // append the next tick
+    void Record(TActionSet actions);
+
+    // Play back from the first tick. Playback() returns false once every tick has been played.
+    void Rewind();
+    bool Playback(TActionSet &actions);
+
+    // files live in the PhysFS write directory
+    bool Save(const char *filename) const;
+    bool Load(const char *filename);
+
+private:
+    typedef struct
+    {
+        TActionSet actions;
+        unsigned short ticks;
+    } TRun;
+
+    std::vector<TRun> m_runs;
+    unsigned int m_seed;
+    unsigned long m_ticks;
+
+    // where playback is up to
+    unsigned int m_playbackRun;
+    unsigned short m_playbackTick;
+
+    enum
+    {
+        FILE_VERSION = 1
+    };
+};
+
+#endif
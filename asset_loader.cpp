@@ -0,0 +1,201 @@
+#include <cassert>
+#include <cstdio>
+#include <vector>
+
+#include <allegro5/allegro.h>
+
+#include "sam_shared.hpp"
+#include "asset_loader.hpp"
+#include "trace.hpp"
+
+TAssetLoader::TAssetLoader() :
+        m_thread(NULL),
+        m_bitmapFormat(ALLEGRO_PIXEL_FORMAT_ANY),
+        m_fileInterface(NULL),
+        m_queueLock(NULL),
+        m_jobsDone(0),
+        m_uploadsQueued(0),
+        m_uploadsDone(0),
+        m_jobsFinished(false),
+        m_failed(false),
+        m_progress(0.0f)
+{
+}
+
+TAssetLoader::~TAssetLoader()
+{
+    // not Finish(), as there may no longer be a display to upload to
+    if (m_thread)
+    {
+        al_join_thread(m_thread, NULL);
+        al_destroy_thread(m_thread);
+    }
+
+    for (std::vector<TUpload>::iterator it = m_queue.begin(); it != m_queue.end(); ++it)
+        al_destroy_bitmap(it->bitmap);
+
+    if (m_queueLock)
+        al_destroy_mutex(m_queueLock);
+}
+
+void TAssetLoader::Add(const char *name, TLoadJob job)
+{
+    assert(m_thread == NULL);
+
+    TJob newJob = { name, job };
+    m_jobs.push_back(newJob);
+}
+
+bool TAssetLoader::Start()
+{
+    assert(m_thread == NULL);
+
+    m_queueLock = al_create_mutex();
+    m_thread = al_create_thread(Thread, this);
+
+    if ((m_queueLock == NULL) || (m_thread == NULL))
+    {
+        fprintf(stderr, "\nERROR: unable to start the asset loader thread");
+        return false;
+    }
+
+    m_bitmapFormat = al_get_new_bitmap_format();
+    m_fileInterface = al_get_new_file_interface();
+    al_start_thread(m_thread);
+
+    return true;
+}
+
+bool TAssetLoader::LoadNow()
+{
+    assert(m_thread == NULL);
+
+    RunJobs();
+
+    return !m_failed;
+}
+
+void *TAssetLoader::Thread(ALLEGRO_THREAD __attribute__ ((unused)) *thread, void *arg)
+{
+    TAssetLoader *loader = (TAssetLoader *)arg;
+
+    // New bitmap flags belong to the thread. There's no display on this one, so nothing made here could
+    // be a video bitmap anyway - this just makes sure of the format. The file interface is per thread too.
+    al_set_new_bitmap_flags(ALLEGRO_MEMORY_BITMAP);
+    al_set_new_bitmap_format(loader->m_bitmapFormat);
+    al_set_new_file_interface(loader->m_fileInterface);
+
+    loader->RunJobs();
+
+    return NULL;
+}
+
+void TAssetLoader::RunJobs()
+{
+    for (std::vector<TJob>::iterator it = m_jobs.begin(); it != m_jobs.end(); ++it)
+    {
+        const double started = al_get_time();
+
+        if (!it->job(*this))
+        {
+            fprintf(stderr, "\nERROR: unable to load %s", it->name);
+            m_failed = true;
+            break;
+        }
+
+        ++m_jobsDone;
+        TRACE_INFO("loaded asset", "job", m_jobsDone, "seconds", al_get_time() - started);
+    }
+
+    m_jobsFinished = true;
+}
+
+void TAssetLoader::QueueUpload(ALLEGRO_BITMAP *bitmap, TUploaded uploaded)
+{
+    assert(bitmap && uploaded);
+
+    // LoadNow()
+    if (m_queueLock == NULL)
+    {
+        uploaded(bitmap);
+        return;
+    }
+
+    TUpload upload = { bitmap, uploaded };
+
+    al_lock_mutex(m_queueLock);
+    m_queue.push_back(upload);
+    ++m_uploadsQueued;
+    al_unlock_mutex(m_queueLock);
+}
+
+void TAssetLoader::Upload(unsigned int maxUploads)
+{
+    TUpload upload;
+    ALLEGRO_BITMAP *video;
+
+    if (m_queueLock == NULL)
+        return;
+
+    for (unsigned int i = 0; i < maxUploads; ++i)
+    {
+        al_lock_mutex(m_queueLock);
+        if (m_queue.empty())
+        {
+            al_unlock_mutex(m_queueLock);
+            break;
+        }
+        upload = m_queue.front();
+        m_queue.erase(m_queue.begin());
+        al_unlock_mutex(m_queueLock);
+
+        video = al_clone_bitmap(upload.bitmap);
+        if (video == NULL)
+        {
+            // still drawable, just slowly
+            fprintf(stderr, "\nWARNING: unable to copy a %dx%d bitmap into video memory",
+                            al_get_bitmap_width(upload.bitmap), al_get_bitmap_height(upload.bitmap));
+            video = upload.bitmap;
+        }
+        else
+            al_destroy_bitmap(upload.bitmap);
+
+        upload.uploaded(video);
+        ++m_uploadsDone;
+    }
+}
+
+float TAssetLoader::Progress()
+{
+    const unsigned int steps = m_jobs.size() + m_uploadsQueued;
+
+    // a job queueing an upload adds a step, which would otherwise look like going backwards
+    if (steps)
+        m_progress = max(m_progress, (float)(m_jobsDone + m_uploadsDone) / steps);
+
+    return m_progress;
+}
+
+bool TAssetLoader::Finished()
+{
+    return m_jobsFinished && (m_uploadsDone == m_uploadsQueued);
+}
+
+bool TAssetLoader::Finish()
+{
+    if (m_thread)
+    {
+        al_join_thread(m_thread, NULL);
+        al_destroy_thread(m_thread);
+        m_thread = NULL;
+    }
+
+    // nothing more can be queued now
+    Upload(m_uploadsQueued - m_uploadsDone);
+
+    if (m_queueLock)
+        al_destroy_mutex(m_queueLock);
+    m_queueLock = NULL;
+
+    return !m_failed;
+}
@@ -0,0 +1,82 @@
+#ifndef _ASSET_LOADER_HPP_
+#define _ASSET_LOADER_HPP_
+
+#include <atomic>
+#include <vector>
+
+#include <allegro5/allegro.h>
+
+// Runs a list of load jobs on a thread of its own, so that the display can keep showing something
+// (the title screen) while files are read and decoded. Jobs make memory bitmaps only - the video card
+// belongs to the display's thread - and hand them over with QueueUpload(). The display's thread then
+// copies them into video memory a few at a time with Upload(), between the frames it draws.
+class TAssetLoader
+{
+public:
+    typedef bool (*TLoadJob)(TAssetLoader &loader);
+
+    // called on the display's thread with the uploaded copy, which replaces the memory bitmap queued
+    typedef void (*TUploaded)(ALLEGRO_BITMAP *bitmap);
+
+    TAssetLoader();
+    ~TAssetLoader();
+
+    // jobs run in the order they were added. A job that fails stops the rest.
+    void Add(const char *name, TLoadJob job);
+
+    // Runs every job on a new thread. Bitmaps queued for upload stay in the queue until Upload() or Finish().
+    bool Start();
+
+    // Runs every job here and now, on the calling thread. Bitmaps aren't copied anywhere, uploaded()
+    // gets them straight from QueueUpload() - e.g. for headless runs, where everything is in memory anyway.
+    bool LoadNow();
+
+    // for jobs to hand over a memory bitmap
+    void QueueUpload(ALLEGRO_BITMAP *bitmap, TUploaded uploaded);
+
+    // Copies at most maxUploads queued bitmaps into video bitmaps (of the calling thread's new bitmap
+    // flags and format). Only from the display's thread.
+    void Upload(unsigned int maxUploads);
+
+    // how much of the loading, uploads included, is done. 0.0 to 1.0, and never goes backwards.
+    float Progress();
+
+    // every job has run and everything they queued has been uploaded
+    bool Finished();
+
+    // Waits for the jobs, then uploads whatever is still queued. False if any job failed.
+    bool Finish();
+
+private:
+    typedef struct
+    {
+        const char *name;
+        TLoadJob job;
+    } TJob;
+
+    typedef struct
+    {
+        ALLEGRO_BITMAP *bitmap;
+        TUploaded uploaded;
+    } TUpload;
+
+    static void *Thread(ALLEGRO_THREAD *thread, void *arg);
+    void RunJobs();
+
+    std::vector<TJob> m_jobs;
+    ALLEGRO_THREAD *m_thread;
+    int m_bitmapFormat; // the display thread's, for the loader thread's bitmaps
+    const ALLEGRO_FILE_INTERFACE *m_fileInterface; // likewise, so that files are still read through PhysFS
+
+    ALLEGRO_MUTEX *m_queueLock; // guards m_queue
+    std::vector<TUpload> m_queue;
+
+    std::atomic<unsigned int> m_jobsDone;
+    std::atomic<unsigned int> m_uploadsQueued;
+    std::atomic<unsigned int> m_uploadsDone;
+    std::atomic<bool> m_jobsFinished;
+    std::atomic<bool> m_failed;
+    float m_progress;
+};
+
+#endif
@@ -0,0 +1,222 @@
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include <allegro5/allegro.h>
+#include <physfs.h>
+
+#include "sam_shared.hpp"
+#include "atlas_cache.hpp"
+#include "collision.hpp"
+#include "sprites.hpp"
+#include "trace.hpp"
+
+// File layout, every value little-endian:
+//   "SATL"                      magic
+//   uint16 version              ATLAS_CACHE_VERSION
+//   uint16 tile width, height   unscaled pixels, as a different tile size means a different atlas
+//   uint64 source hash          HashFile() of the image the atlas was made from
+//   uint32 width, height        of the atlas, in pixels
+//   uint32 tile count           of the collision masks and sprite frames
+// then the pixels, top row first, in ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE so that they can be read
+// straight into a locked bitmap, then TILE_HEIGHT_PIXELS_UNSCALED uint32 mask rows per tile, and
+// then a sprite frame per tile: uint16 x, y, then uint8 offsetX, offsetY, width, height.
+static const char ATLAS_CACHE_MAGIC[4] = { 'S', 'A', 'T', 'L' };
+
+enum
+{
+    ATLAS_CACHE_VERSION = 2, // 2: the atlas is packed, and sprite frames follow the masks
+
+    IO_BUFFER_BYTES = 64 * 1024
+};
+
+bool HashFile(const char *filename, PHYSFS_uint64 &hash)
+{
+    PHYSFS_File *file = PHYSFS_openRead(filename);
+    unsigned char buffer[4096];
+    PHYSFS_sint64 got;
+
+    if (file == NULL)
+        return false;
+
+    hash = 14695981039346656037ULL;
+    while ((got = PHYSFS_read(file, buffer, 1, sizeof(buffer))) > 0)
+    {
+        for (PHYSFS_sint64 i = 0; i < got; ++i)
+            hash = (hash ^ buffer[i]) * 1099511628211ULL;
+    }
+
+    PHYSFS_close(file);
+
+    return got == 0;
+}
+
+ALLEGRO_BITMAP *LoadCachedAtlas(const char *cacheFilename, PHYSFS_uint64 sourceHash)
+{
+    PHYSFS_File *file;
+    char magic[sizeof(ATLAS_CACHE_MAGIC)];
+    PHYSFS_uint16 version = 0, tileWidth, tileHeight;
+    PHYSFS_uint64 hash;
+    PHYSFS_uint32 width, height, tileCount = 0;
+    ALLEGRO_BITMAP *atlas;
+    ALLEGRO_LOCKED_REGION *region;
+    bool ok = true;
+
+    if (!PHYSFS_exists(cacheFilename))
+        return NULL;
+
+    file = PHYSFS_openRead(cacheFilename);
+    if (file == NULL)
+        return NULL;
+
+    PHYSFS_setBuffer(file, IO_BUFFER_BYTES);
+
+    if ((PHYSFS_read(file, magic, sizeof(magic), 1) != 1) || (memcmp(magic, ATLAS_CACHE_MAGIC, sizeof(magic)) != 0) ||
+        !PHYSFS_readULE16(file, &version) || !PHYSFS_readULE16(file, &tileWidth) || !PHYSFS_readULE16(file, &tileHeight) ||
+        !PHYSFS_readULE64(file, &hash) ||
+        !PHYSFS_readULE32(file, &width) || !PHYSFS_readULE32(file, &height) || !PHYSFS_readULE32(file, &tileCount) ||
+        (version != ATLAS_CACHE_VERSION) || (tileWidth != TILE_WIDTH_PIXELS_UNSCALED) || (tileHeight != TILE_HEIGHT_PIXELS_UNSCALED) ||
+        (hash != sourceHash) || (tileCount == 0) || (width == 0) || (height == 0))
+    {
+        TRACE_INFO("tile atlas cache out of date", "version", version, "tiles", tileCount);
+        PHYSFS_close(file);
+        return NULL;
+    }
+
+    atlas = al_create_bitmap(width, height);
+    if (atlas == NULL)
+    {
+        PHYSFS_close(file);
+        return NULL;
+    }
+
+    // the pixels go straight from the file into the bitmap, with nothing to decode or convert
+    region = al_lock_bitmap(atlas, ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE, ALLEGRO_LOCK_WRITEONLY);
+    if (region == NULL)
+        ok = false;
+    else
+    {
+        // pitch is negative for bitmaps stored bottom-up, so keep this arithmetic signed
+        for (signed int row = 0; ok && (row < (signed int)height); ++row)
+            ok = (PHYSFS_read(file, (unsigned char *)region->data + (row * region->pitch), width * 4, 1) == 1);
+
+        al_unlock_bitmap(atlas);
+    }
+
+    std::vector<TMaskRow> masks(tileCount * TILE_HEIGHT_PIXELS_UNSCALED);
+    for (std::vector<TMaskRow>::iterator it = masks.begin(); ok && (it != masks.end()); ++it)
+    {
+        PHYSFS_uint32 row;
+
+        ok = PHYSFS_readULE32(file, &row);
+        *it = row;
+    }
+
+    std::vector<TSpriteRegistry::TFrame> frames(tileCount);
+    for (std::vector<TSpriteRegistry::TFrame>::iterator it = frames.begin(); ok && (it != frames.end()); ++it)
+    {
+        unsigned char extents[4];
+
+        ok = PHYSFS_readULE16(file, &it->x) && PHYSFS_readULE16(file, &it->y) &&
+             (PHYSFS_read(file, extents, sizeof(extents), 1) == 1);
+
+        it->offsetX = extents[0];
+        it->offsetY = extents[1];
+        it->width   = extents[2];
+        it->height  = extents[3];
+
+        // a frame reaching outside the atlas or its tile means the file is damaged
+        if (ok && ((it->x + it->width > width) || (it->y + it->height > height) ||
+                   (it->Right() > TILE_WIDTH_PIXELS_UNSCALED) || (it->Bottom() > TILE_HEIGHT_PIXELS_UNSCALED)))
+            ok = false;
+    }
+
+    PHYSFS_close(file);
+
+    if (!ok)
+    {
+        fprintf(stderr, "\nWARNING: tile atlas cache '%s' is unreadable, rebuilding it", cacheFilename);
+        al_destroy_bitmap(atlas);
+        return NULL;
+    }
+
+    SetCollisionMasks(&masks[0], tileCount);
+    GLOBALS::sprites.SetFrames(atlas, frames);
+
+    TRACE_INFO("loaded cached tile atlas", "width", width, "height", height);
+
+    return atlas;
+}
+
+bool SaveCachedAtlas(const char *cacheFilename, PHYSFS_uint64 sourceHash, ALLEGRO_BITMAP *atlas)
+{
+    const PHYSFS_uint32 width = al_get_bitmap_width(atlas);
+    const PHYSFS_uint32 height = al_get_bitmap_height(atlas);
+    const unsigned int tileCount = CollisionMaskTileCount();
+    PHYSFS_File *file = PHYSFS_openWrite(cacheFilename);
+    ALLEGRO_LOCKED_REGION *region;
+    bool ok;
+
+    if (file == NULL)
+    {
+        fprintf(stderr, "\nWARNING: unable to create tile atlas cache '%s'. Specifically:\n\t'%s'",
+                        cacheFilename, PHYSFS_getLastError());
+        return false;
+    }
+
+    PHYSFS_setBuffer(file, IO_BUFFER_BYTES);
+
+    ok = (PHYSFS_write(file, ATLAS_CACHE_MAGIC, sizeof(ATLAS_CACHE_MAGIC), 1) == 1) &&
+         PHYSFS_writeULE16(file, ATLAS_CACHE_VERSION) &&
+         PHYSFS_writeULE16(file, TILE_WIDTH_PIXELS_UNSCALED) &&
+         PHYSFS_writeULE16(file, TILE_HEIGHT_PIXELS_UNSCALED) &&
+         PHYSFS_writeULE64(file, sourceHash) &&
+         PHYSFS_writeULE32(file, width) &&
+         PHYSFS_writeULE32(file, height) &&
+         PHYSFS_writeULE32(file, tileCount);
+
+    region = ok ? al_lock_bitmap(atlas, ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE, ALLEGRO_LOCK_READONLY) : NULL;
+    if (region == NULL)
+        ok = false;
+    else
+    {
+        for (signed int row = 0; ok && (row < (signed int)height); ++row)
+            ok = (PHYSFS_write(file, (const unsigned char *)region->data + (row * region->pitch), width * 4, 1) == 1);
+
+        al_unlock_bitmap(atlas);
+    }
+
+    for (unsigned int tileID = 0; ok && (tileID < tileCount); ++tileID)
+    {
+        const TMaskRow *mask = CollisionMaskOfTile(tileID);
+
+        for (signed int row = 0; ok && (row < TILE_HEIGHT_PIXELS_UNSCALED); ++row)
+            ok = PHYSFS_writeULE32(file, mask[row]);
+    }
+
+    for (unsigned int tileID = 0; ok && (tileID < tileCount); ++tileID)
+    {
+        const TSpriteRegistry::TFrame &frame = GLOBALS::sprites.Frame(tileID);
+        const unsigned char extents[4] = { frame.offsetX, frame.offsetY, frame.width, frame.height };
+
+        ok = PHYSFS_writeULE16(file, frame.x) && PHYSFS_writeULE16(file, frame.y) &&
+             (PHYSFS_write(file, extents, sizeof(extents), 1) == 1);
+    }
+
+    // closing writes out whatever is still buffered
+    if (!PHYSFS_close(file))
+        ok = false;
+
+    if (!ok)
+    {
+        // half a cache would only be thrown away next time
+        fprintf(stderr, "\nWARNING: unable to write tile atlas cache '%s'. Specifically:\n\t'%s'",
+                        cacheFilename, PHYSFS_getLastError());
+        PHYSFS_delete(cacheFilename);
+        return false;
+    }
+
+    TRACE_INFO("saved tile atlas cache", "width", width, "height", height);
+
+    return true;
+}
@@ -0,0 +1,24 @@
+#ifndef _ATLAS_CACHE_HPP_
+#define _ATLAS_CACHE_HPP_
+
+#include <allegro5/allegro.h>
+#include <physfs.h>
+
+// The sprite atlas as the game uses it - scaled up to the "unscaled" tile size, trimmed and packed - plus
+// the collision masks and sprite frames, saved in the PhysFS write directory so that later runs can skip
+// decoding, scaling and packing the source image.
+// The cache is keyed by a hash of the source image's bytes, so replacing the image replaces the cache.
+
+// FNV-1a of every byte of a file, read through PhysFS
+bool HashFile(const char *filename, PHYSFS_uint64 &hash);
+
+// The cached atlas, created with the current new bitmap flags and with its collision masks and sprite
+// frames already in place (see SetCollisionMasks, TSpriteRegistry::SetFrames). NULL if there's no cache,
+// or it's out of date or unreadable.
+ALLEGRO_BITMAP *LoadCachedAtlas(const char *cacheFilename, PHYSFS_uint64 sourceHash);
+
+// Saves the packed atlas along with the current collision masks and GLOBALS::sprites frames.
+// Failing to is only worth a warning.
+bool SaveCachedAtlas(const char *cacheFilename, PHYSFS_uint64 sourceHash, ALLEGRO_BITMAP *atlas);
+
+#endif
@@ -0,0 +1,232 @@
+#include <cstdio>
+#include <vector>
+#include <unordered_map>
+
+#include <allegro5/allegro.h>
+
+#include "sam_shared.hpp"
+#include "level.hpp"
+#include "background.hpp"
+#include "snapshot.hpp"
+#include "sprites.hpp"
+#include "trace.hpp"
+
+namespace GLOBALS
+{
+    TBackgroundCache background;
+}
+
+TBackgroundCache::TBackgroundCache() :
+        m_useClock(0)
+{
+    for (unsigned int i = 0; i < CACHE_SLOTS; ++i)
+    {
+        m_slots[i].bitmap = NULL;
+        m_slots[i].valid = false;
+    }
+}
+
+TBackgroundCache::~TBackgroundCache()
+{
+    // the bitmaps belong to Allegro, which has been shut down by now
+}
+
+bool TBackgroundCache::Create()
+{
+    for (unsigned int i = 0; i < CACHE_SLOTS; ++i)
+    {
+        m_slots[i].bitmap = al_create_bitmap(VIEWPORT_WIDTH_PIXELS_UNSCALED, VIEWPORT_HEIGHT_PIXELS_UNSCALED);
+        if (m_slots[i].bitmap == NULL)
+        {
+            fprintf(stderr, "\nERROR: unable to create the background cache bitmaps");
+            Destroy();
+            return false;
+        }
+        m_slots[i].valid = false;
+    }
+
+    return true;
+}
+
+void TBackgroundCache::Destroy()
+{
+    for (unsigned int i = 0; i < CACHE_SLOTS; ++i)
+    {
+        if (m_slots[i].bitmap)
+            al_destroy_bitmap(m_slots[i].bitmap);
+        m_slots[i].bitmap = NULL;
+        m_slots[i].valid = false;
+    }
+}
+
+void TBackgroundCache::Invalidate()
+{
+    for (unsigned int i = 0; i < CACHE_SLOTS; ++i)
+        m_slots[i].valid = false;
+}
+
+TBackgroundCache::TSlot *TBackgroundCache::Find(signed int chunkX, signed int chunkY)
+{
+    for (unsigned int i = 0; i < CACHE_SLOTS; ++i)
+    {
+        if (m_slots[i].valid && (m_slots[i].chunkX == chunkX) && (m_slots[i].chunkY == chunkY))
+            return &m_slots[i];
+    }
+
+    return NULL;
+}
+
+TBackgroundCache::TSlot *TBackgroundCache::NextSlot()
+{
+    TSlot *slot = &m_slots[0];
+
+    // an empty slot if there is one, otherwise the least recently used
+    for (unsigned int i = 1; (i < CACHE_SLOTS) && slot->valid; ++i)
+    {
+        if (!m_slots[i].valid || (m_slots[i].lastUsed < slot->lastUsed))
+            slot = &m_slots[i];
+    }
+
+    return slot;
+}
+
+TTileRect TBackgroundCache::ChunkRect(const TWorldSnapshot &snapshot, signed int chunkX, signed int chunkY)
+{
+    const TTileRect rect = { chunkX * VIEWPORT_WIDTH_TILES, chunkY * VIEWPORT_HEIGHT_TILES,
+                             min(snapshot.levelWidthTiles,  (chunkX + 1) * VIEWPORT_WIDTH_TILES)  - 1,
+                             min(snapshot.levelHeightTiles, (chunkY + 1) * VIEWPORT_HEIGHT_TILES) - 1 };
+
+    return rect;
+}
+
+void TBackgroundCache::RenderTiles(const TWorldSnapshot &snapshot, const TSlot &slot, const TTileRect &rect)
+{
+    const signed int firstTileX = slot.chunkX * VIEWPORT_WIDTH_TILES;
+    const signed int firstTileY = slot.chunkY * VIEWPORT_HEIGHT_TILES;
+    const signed int lastTileX = min(snapshot.levelWidthTiles  - 1, rect.right);
+    const signed int lastTileY = min(snapshot.levelHeightTiles - 1, rect.bottom);
+    ALLEGRO_BITMAP *target = al_get_target_bitmap();
+    signed int tileID;
+
+    al_set_target_bitmap(slot.bitmap);
+
+    // clear to a reasonable sky blue color so that the background layer of the map is not required to be completely filled in.
+    // Only the tiles being rendered, the rest of the chunk is still good.
+    al_set_clipping_rectangle(TILE_WIDTH_PIXELS_UNSCALED * (rect.left - firstTileX), TILE_HEIGHT_PIXELS_UNSCALED * (rect.top - firstTileY),
+                              TILE_WIDTH_PIXELS_UNSCALED * (rect.right - rect.left + 1), TILE_HEIGHT_PIXELS_UNSCALED * (rect.bottom - rect.top + 1));
+    al_clear_to_color(al_map_rgb(50,50,200));
+
+    GLOBALS::sprites.BeginBatch();
+
+    for (signed int y = rect.top; y <= lastTileY; ++y)
+    {
+        for (signed int x = rect.left; x <= lastTileX; ++x)
+        {
+            tileID = snapshot.BackTile(x, y);
+
+            if (tileID != -1)
+                GLOBALS::sprites.Draw(tileID, TILE_WIDTH_PIXELS_UNSCALED * (x - firstTileX), TILE_HEIGHT_PIXELS_UNSCALED * (y - firstTileY));
+
+            // anything that was spawned as an interactive draws itself, and has already been left out
+            tileID = snapshot.MidTile(x, y);
+
+            if (tileID != -1)
+                GLOBALS::sprites.Draw(tileID, TILE_WIDTH_PIXELS_UNSCALED * (x - firstTileX), TILE_HEIGHT_PIXELS_UNSCALED * (y - firstTileY));
+        }
+    }
+
+    GLOBALS::sprites.EndBatch();
+
+    al_reset_clipping_rectangle();
+    al_set_target_bitmap(target);
+}
+
+TBackgroundCache::TSlot *TBackgroundCache::Render(const TWorldSnapshot &snapshot, signed int chunkX, signed int chunkY)
+{
+    TSlot *slot = NextSlot();
+
+    // the whole chunk, including any of it hanging off the edge of the level
+    const TTileRect whole = { chunkX * VIEWPORT_WIDTH_TILES, chunkY * VIEWPORT_HEIGHT_TILES,
+                              ((chunkX + 1) * VIEWPORT_WIDTH_TILES) - 1, ((chunkY + 1) * VIEWPORT_HEIGHT_TILES) - 1 };
+
+    slot->chunkX = chunkX;
+    slot->chunkY = chunkY;
+    RenderTiles(snapshot, *slot, whole);
+
+    slot->lastUsed = ++m_useClock;
+    slot->valid = true;
+
+    TRACE_DEBUG("rendered background chunk", "x", chunkX, "y", chunkY);
+
+    return slot;
+}
+
+void TBackgroundCache::Redraw(const TWorldSnapshot &snapshot, const TTileRect &rect)
+{
+    for (unsigned int i = 0; i < CACHE_SLOTS; ++i)
+    {
+        if (!m_slots[i].valid)
+            continue;
+
+        const TTileRect overlap = { max(rect.left,   m_slots[i].chunkX * VIEWPORT_WIDTH_TILES),
+                                    max(rect.top,    m_slots[i].chunkY * VIEWPORT_HEIGHT_TILES),
+                                    min(rect.right,  ((m_slots[i].chunkX + 1) * VIEWPORT_WIDTH_TILES) - 1),
+                                    min(rect.bottom, ((m_slots[i].chunkY + 1) * VIEWPORT_HEIGHT_TILES) - 1) };
+
+        if ((overlap.left > overlap.right) || (overlap.top > overlap.bottom))
+            continue;
+
+        if (snapshot.InWindow(ChunkRect(snapshot, m_slots[i].chunkX, m_slots[i].chunkY)))
+            RenderTiles(snapshot, m_slots[i], overlap);
+        else
+            m_slots[i].valid = false;
+    }
+}
+
+void TBackgroundCache::Draw(const TWorldSnapshot &snapshot, signed int worldX, signed int worldY)
+{
+    const signed int chunksWide = (snapshot.levelWidthTiles  + VIEWPORT_WIDTH_TILES  - 1) / VIEWPORT_WIDTH_TILES;
+    const signed int chunksHigh = (snapshot.levelHeightTiles + VIEWPORT_HEIGHT_TILES - 1) / VIEWPORT_HEIGHT_TILES;
+    signed int chunkX, chunkY;
+    TSlot *slot;
+
+    for (chunkY = worldY / VIEWPORT_HEIGHT_PIXELS_UNSCALED; chunkY <= (worldY + VIEWPORT_HEIGHT_PIXELS_UNSCALED - 1) / VIEWPORT_HEIGHT_PIXELS_UNSCALED; ++chunkY)
+    {
+        for (chunkX = worldX / VIEWPORT_WIDTH_PIXELS_UNSCALED; chunkX <= (worldX + VIEWPORT_WIDTH_PIXELS_UNSCALED - 1) / VIEWPORT_WIDTH_PIXELS_UNSCALED; ++chunkX)
+        {
+            slot = Find(chunkX, chunkY);
+            if (slot == NULL)
+                slot = Render(snapshot, chunkX, chunkY);
+
+            slot->lastUsed = ++m_useClock;
+            al_draw_bitmap(slot->bitmap, (chunkX * VIEWPORT_WIDTH_PIXELS_UNSCALED)  - worldX,
+                                         (chunkY * VIEWPORT_HEIGHT_PIXELS_UNSCALED) - worldY, 0);
+        }
+    }
+
+    // the chunks within APPROACH_PIXELS of the viewport
+    const signed int nearLeft   = max(0,              (worldX - APPROACH_PIXELS) / VIEWPORT_WIDTH_PIXELS_UNSCALED);
+    const signed int nearTop    = max(0,              (worldY - APPROACH_PIXELS) / VIEWPORT_HEIGHT_PIXELS_UNSCALED);
+    const signed int nearRight  = min(chunksWide - 1, (worldX + VIEWPORT_WIDTH_PIXELS_UNSCALED  + APPROACH_PIXELS - 1) / VIEWPORT_WIDTH_PIXELS_UNSCALED);
+    const signed int nearBottom = min(chunksHigh - 1, (worldY + VIEWPORT_HEIGHT_PIXELS_UNSCALED + APPROACH_PIXELS - 1) / VIEWPORT_HEIGHT_PIXELS_UNSCALED);
+
+    for (chunkY = nearTop; chunkY <= nearBottom; ++chunkY)
+    {
+        for (chunkX = nearLeft; chunkX <= nearRight; ++chunkX)
+        {
+            // not yet, if the snapshot hasn't got all of its tiles
+            if (Find(chunkX, chunkY) || !snapshot.InWindow(ChunkRect(snapshot, chunkX, chunkY)))
+                continue;
+
+            // only if it can have a slot that isn't also needed around here, or the two would take turns forever
+            slot = NextSlot();
+
+            if (!slot->valid ||
+                (slot->chunkX < nearLeft) || (slot->chunkX > nearRight) || (slot->chunkY < nearTop) || (slot->chunkY > nearBottom))
+            {
+                Render(snapshot, chunkX, chunkY);
+            }
+            return;
+        }
+    }
+}
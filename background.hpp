@@ -0,0 +1,67 @@
+#ifndef _BACKGROUND_HPP_
+#define _BACKGROUND_HPP_
+
+#include <allegro5/allegro.h>
+
+#include "level.hpp"
+#include "snapshot.hpp"
+
+// The back and mid layers of the level, pre-rendered a viewport-sized chunk at a time into a small
+// least-recently-used cache of bitmaps. Chunks are rendered when the camera comes near them, so however
+// big the level is, the background never takes more than CACHE_SLOTS screens' worth of texture memory.
+//
+// The tiles come from a snapshot's window rather than the level itself, which belongs to the simulation.
+class TBackgroundCache
+{
+public:
+    TBackgroundCache();
+    ~TBackgroundCache();
+
+    // makes all the cache's bitmaps up front, with the current new bitmap flags
+    bool Create();
+    void Destroy();
+
+    // forget everything rendered so far, e.g. because a different level has been loaded
+    void Invalidate();
+
+    // Re-renders just the tiles in rect, in whichever cached chunks it overlaps. A chunk that snapshot
+    // doesn't have the tiles for is forgotten instead, and rendered again when it's next needed.
+    void Redraw(const TWorldSnapshot &snapshot, const TTileRect &rect);
+
+    // Draws the background as seen from worldX, worldY (unscaled pixels, top left of the viewport) to the
+    // current target bitmap, rendering whichever of the 1-4 visible chunks aren't cached yet. Then renders
+    // at most one chunk the camera is getting close to, so that it's ready before it comes into view.
+    void Draw(const TWorldSnapshot &snapshot, signed int worldX, signed int worldY);
+
+    enum
+    {
+        CACHE_SLOTS = 6, // the 4 a view can straddle, plus room to render ahead
+
+        APPROACH_PIXELS = 128 // unscaled. How near the viewport a chunk has to be to be rendered ahead.
+    };
+
+private:
+    typedef struct
+    {
+        ALLEGRO_BITMAP *bitmap;
+        signed int chunkX, chunkY;
+        unsigned int lastUsed;
+        bool valid;
+    } TSlot;
+
+    TSlot *Find(signed int chunkX, signed int chunkY);
+    TSlot *NextSlot(); // the one the next chunk to be rendered will go in
+    TSlot *Render(const TWorldSnapshot &snapshot, signed int chunkX, signed int chunkY);
+    void RenderTiles(const TWorldSnapshot &snapshot, const TSlot &slot, const TTileRect &rect); // rect is in level tiles, within the slot's chunk
+    TTileRect ChunkRect(const TWorldSnapshot &snapshot, signed int chunkX, signed int chunkY); // just the part within the level
+
+    TSlot m_slots[CACHE_SLOTS];
+    unsigned int m_useClock;
+};
+
+namespace GLOBALS
+{
+    extern TBackgroundCache background;
+}
+
+#endif
@@ -0,0 +1,313 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <new>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <chrono>
+#include <atomic>
+
+#include <allegro5/allegro.h>
+#include <allegro5/allegro_font.h>
+
+#include "sam_shared.hpp"
+
+#include "interactives.hpp"
+#include "collision.hpp"
+
+#include "level.hpp"
+#include "background.hpp"
+#include "snapshot.hpp"
+#include "sprites.hpp"
+
+// Micro-benchmarks for the routines that run every tick or every frame. Built as sam_benchmark.exe
+// (make sam_benchmark), linking the game's own object files, and run from the game directory so
+// that tiles.png can be found. Everything is drawn into memory bitmaps so no display is needed.
+//
+// Each benchmark is run as a number of samples of a fixed number of operations. Results are written
+// as one JSON object per line, to stdout or to the file named on the command line.
+
+// every heap allocation made while a benchmark runs, both by C++ and by Allegro
+static unsigned long s_allocations = 0;
+
+void *operator new(size_t size)
+{
+    void *p = malloc(size ? size : 1);
+
+    if (p == NULL)
+        throw std::bad_alloc();
+
+    ++s_allocations;
+    return p;
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+static void *CountingMalloc(size_t n, int, const char *, const char *)
+{
+    ++s_allocations;
+    return malloc(n);
+}
+
+static void CountingFree(void *ptr, int, const char *, const char *)
+{
+    free(ptr);
+}
+
+static void *CountingRealloc(void *ptr, size_t n, int, const char *, const char *)
+{
+    ++s_allocations;
+    return realloc(ptr, n);
+}
+
+static void *CountingCalloc(size_t count, size_t n, int, const char *, const char *)
+{
+    ++s_allocations;
+    return calloc(count, n);
+}
+
+static ALLEGRO_MEMORY_INTERFACE s_countingMemory = { CountingMalloc, CountingFree, CountingRealloc, CountingCalloc };
+
+// keeps the compiler from optimizing away results nobody looks at
+static volatile unsigned long s_sink;
+
+// pseudo-random but repeatable spots across the level, clear of the right and bottom edges
+static signed int BenchX(unsigned int op) { return (op * 37) % (GLOBALS::level.WidthPixels()  - TILE_WIDTH_PIXELS_UNSCALED); }
+static signed int BenchY(unsigned int op) { return (op * 53) % (GLOBALS::level.HeightPixels() - TILE_HEIGHT_PIXELS_UNSCALED); }
+
+static void BenchObjectCollide(unsigned int op)
+{
+    // the player against an ammo pickup, at every offset where their boxes overlap
+    s_sink += ObjectCollide(GLOBALS::player.TileID(), 64, 64,
+                            TAmmo::TILE_ID, 64 + (signed int)(op % 63) - 31, 64 + (signed int)((op / 63) % 63) - 31);
+}
+
+static void BenchOnSolidGround(unsigned int op)
+{
+    GLOBALS::player.m_x = BenchX(op);
+    GLOBALS::player.m_y = BenchY(op);
+    s_sink += OnSolidGround();
+}
+
+static void BenchSweepBox(unsigned int op)
+{
+    // alternately a jump's worth up, and a fall's worth down, from a player sized box
+    const TSweepResult hit = SweepBox(BenchX(op), BenchY(op), TILE_WIDTH_PIXELS_UNSCALED, TILE_HEIGHT_PIXELS_UNSCALED,
+                                      0.0, (op & 1) ? -3.0 * TILE_HEIGHT_PIXELS_UNSCALED : 3.0 * TILE_HEIGHT_PIXELS_UNSCALED);
+    s_sink += hit.distance;
+}
+
+static void BenchInDeathSquare(unsigned int op)
+{
+    GLOBALS::player.m_x = BenchX(op);
+    GLOBALS::player.m_y = BenchY(op);
+    s_sink += InDeathSquare();
+}
+
+// needs to be a friend of TPlayer to get at the movement routines
+class TPlayerBenchmark
+{
+public:
+    static void MoveHorizontal(unsigned int op)
+    {
+        TPlayer &player = GLOBALS::player;
+
+        player.m_x = BenchX(op);
+        player.m_y = BenchY(op);
+        player.m_facing = (op & 1) ? eFACING_LEFT : eFACING_RIGHT;
+        player.m_xVelocityPerSecond = TPlayer::MAX_X_VELOCITY_PER_SECOND;
+
+        player.MoveHorizontal(SIMULATION_TICK_SECONDS);
+        s_sink += player.m_x;
+    }
+
+    static void MoveVertical(unsigned int op)
+    {
+        TPlayer &player = GLOBALS::player;
+
+        player.m_x = BenchX(op);
+        player.m_y = BenchY(op);
+        player.m_state = TPlayer::eSTATE_FALLING;
+        player.m_xVelocityPerSecond = 0;
+
+        // alternately on the way up in a jump, and falling
+        player.m_yVelocityPerSecond = (op & 1) ? -TPlayer::MAX_Y_VELOCITY_PER_SECOND : TPlayer::MAX_Y_VELOCITY_PER_SECOND;
+
+        player.MoveVertical(SIMULATION_TICK_SECONDS);
+        s_sink += player.m_y;
+    }
+};
+
+// the world around the top left of the level, as the display would get it
+static TWorldSnapshot s_originSnapshot;
+
+static void BenchBackgroundChunk(unsigned int)
+{
+    // a view lined up on a single chunk, rendered from scratch every time
+    GLOBALS::background.Invalidate();
+    GLOBALS::background.Draw(s_originSnapshot, 0, 0);
+}
+
+static ALLEGRO_BITMAP *s_screen = NULL;
+static TWorldSnapshot s_snapshot;
+
+static void BenchDrawFrame(unsigned int op)
+{
+    GLOBALS::player.m_x = BenchX(op);
+    GLOBALS::player.m_y = BenchY(op);
+    GLOBALS::player.StorePreviousPosition();
+
+    // taking the snapshot is as much a part of every frame as drawing it
+    FillSnapshot(s_snapshot, 0.0);
+
+    al_set_target_bitmap(s_screen);
+    DrawFrame(s_snapshot, 1.0);
+}
+
+static void BenchSpriteBatch(unsigned int op)
+{
+    // a crowded screen's worth of sprites, every tile in the atlas in turn
+    al_set_target_bitmap(s_screen);
+    GLOBALS::sprites.BeginBatch();
+    for (unsigned int i = 0; i < 256; ++i)
+        GLOBALS::sprites.Draw((op + i) % GLOBALS::sprites.Count(), (i % 16) * 40, (i / 16) * 30);
+    GLOBALS::sprites.EndBatch();
+}
+
+typedef struct
+{
+    const char *name;
+    void (*op)(unsigned int op);
+    unsigned int samples;
+    unsigned int opsPerSample;
+} TBenchmark;
+
+static const TBenchmark BENCHMARKS[] =
+{
+    { "ObjectCollide",           BenchObjectCollide,             200, 10000 },
+    { "OnSolidGround",           BenchOnSolidGround,             200, 10000 },
+    { "SweepBox",                BenchSweepBox,                  200, 10000 },
+    { "InDeathSquare",           BenchInDeathSquare,             200, 10000 },
+    { "TPlayer::MoveHorizontal", TPlayerBenchmark::MoveHorizontal, 200, 10000 },
+    { "TPlayer::MoveVertical",   TPlayerBenchmark::MoveVertical,   200,  1000 },
+    { "TBackgroundCache chunk",  BenchBackgroundChunk,            20,     1 },
+    { "RedrawScreen",            BenchDrawFrame,                  20,     1 },
+    { "TSpriteRegistry batch",   BenchSpriteBatch,                20,     1 },
+};
+
+// sorted must be sorted ascending
+static double Percentile(const std::vector<double> &sorted, double percent)
+{
+    const unsigned int rank = ceil((percent / 100.0) * sorted.size());
+
+    return sorted[rank ? rank - 1 : 0];
+}
+
+static void RunBenchmark(const TBenchmark &benchmark, FILE *output)
+{
+    std::vector<double> nsPerOp(benchmark.samples);
+    unsigned long allocationsBefore;
+    unsigned int op = 0;
+    double total = 0.0;
+
+    // one untimed sample first, to warm up the caches and anything lazily created
+    for (unsigned int i = 0; i < benchmark.opsPerSample; ++i)
+        benchmark.op(op++);
+
+    allocationsBefore = s_allocations;
+
+    for (unsigned int sample = 0; sample < benchmark.samples; ++sample)
+    {
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        for (unsigned int i = 0; i < benchmark.opsPerSample; ++i)
+            benchmark.op(op++);
+
+        const std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+        nsPerOp[sample] = std::chrono::duration<double, std::nano>(end - start).count() / benchmark.opsPerSample;
+        total += nsPerOp[sample];
+    }
+
+    const double allocationsPerOp = double(s_allocations - allocationsBefore) / (double(benchmark.samples) * benchmark.opsPerSample);
+
+    std::sort(nsPerOp.begin(), nsPerOp.end());
+
+    fprintf(output, "{\"benchmark\": \"%s\", \"samples\": %u, \"ops_per_sample\": %u, "
+                    "\"ns_per_op\": {\"mean\": %.2f, \"min\": %.2f, \"p50\": %.2f, \"p90\": %.2f, \"p99\": %.2f, \"max\": %.2f}, "
+                    "\"allocations_per_op\": %.4f}\n",
+                    benchmark.name, benchmark.samples, benchmark.opsPerSample,
+                    total / benchmark.samples, nsPerOp.front(),
+                    Percentile(nsPerOp, 50), Percentile(nsPerOp, 90), Percentile(nsPerOp, 99), nsPerOp.back(),
+                    allocationsPerOp);
+    fflush(output);
+}
+
+int main(int argc, char **argv)
+{
+    FILE *output = stdout;
+
+    if (argc > 2)
+    {
+        fprintf(stderr, "\nusage: %s [output file]\n", argv[0]);
+        return -1;
+    }
+
+    // has to be in place before Allegro allocates anything
+    al_set_memory_interface(&s_countingMemory);
+
+    // the simulation parts of InitGame(), all in memory bitmaps
+    GLOBALS::headless = true;
+    if (!InitGame(argc, argv))
+    {
+        fprintf(stderr, "\nInitialization failed.\n");
+        return -1;
+    }
+
+    // plus the drawing parts that a headless run leaves out
+    al_init_font_addon();
+    GLOBALS::defaultFont = al_create_builtin_font();
+    s_screen = al_create_bitmap(FRAME_WIDTH_PIXELS_UNSCALED, FRAME_HEIGHT_PIXELS_UNSCALED);
+
+    if ((GLOBALS::defaultFont == NULL) || !GLOBALS::background.Create() || (s_screen == NULL))
+    {
+        fprintf(stderr, "\nERROR: unable to create benchmark bitmaps\n");
+        return -1;
+    }
+
+    ResetLevel();
+
+    GLOBALS::player.m_x = 0;
+    GLOBALS::player.m_y = 0;
+    GLOBALS::player.StorePreviousPosition();
+    FillSnapshot(s_originSnapshot, 0.0);
+
+    if (argc == 2)
+    {
+        output = fopen(argv[1], "w");
+        if (output == NULL)
+        {
+            fprintf(stderr, "\nERROR: unable to create '%s'\n", argv[1]);
+            return -1;
+        }
+    }
+
+    for (unsigned int i = 0; i < sizeof(BENCHMARKS) / sizeof(BENCHMARKS[0]); ++i)
+        RunBenchmark(BENCHMARKS[i], output);
+
+    if (output != stdout)
+        fclose(output);
+
+    al_destroy_bitmap(s_screen);
+    GLOBALS::background.Destroy();
+    al_destroy_font(GLOBALS::defaultFont);
+    al_shutdown_font_addon();
+
+    ShutdownGame();
+
+    return 0;
+}
@@ -0,0 +1,250 @@
+#include <cassert>
+#include <cstdio>
+#include <cmath>
+#include <vector>
+#include <unordered_map>
+
+#include "sam_shared.hpp"
+#include "collision.hpp"
+
+#include "level.hpp"
+
+// TILE_HEIGHT_PIXELS_UNSCALED mask rows for each tile in the atlas, stored one tile after the other
+static std::vector<TMaskRow> s_masks;
+static unsigned int s_tileCount = 0;
+
+bool BuildCollisionMasks(ALLEGRO_BITMAP *atlas)
+{
+    assert(atlas);
+
+    // every pixel row of a tile has to fit within a single mask word
+    assert(TILE_WIDTH_PIXELS_UNSCALED <= 32);
+
+    const unsigned int atlasWidth_tiles  = al_get_bitmap_width(atlas)  / TILE_WIDTH_PIXELS_UNSCALED;
+    const unsigned int atlasHeight_tiles = al_get_bitmap_height(atlas) / TILE_HEIGHT_PIXELS_UNSCALED;
+
+    // ask for a fixed byte order so that alpha is always the 4th byte of each pixel, no matter
+    // how the video driver happens to store the atlas internally
+    ALLEGRO_LOCKED_REGION *region = al_lock_bitmap(atlas, ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE, ALLEGRO_LOCK_READONLY);
+    if (region == NULL)
+    {
+        fprintf(stderr, "\nERROR: unable to lock tilesheet to build collision masks");
+        return false;
+    }
+
+    s_tileCount = atlasWidth_tiles * atlasHeight_tiles;
+    s_masks.assign(s_tileCount * TILE_HEIGHT_PIXELS_UNSCALED, 0);
+
+    for (unsigned int tileID = 0; tileID < s_tileCount; ++tileID)
+    {
+        const signed int pixelX = (tileID % atlasWidth_tiles) * TILE_WIDTH_PIXELS_UNSCALED;
+        const signed int pixelY = (tileID / atlasWidth_tiles) * TILE_HEIGHT_PIXELS_UNSCALED;
+
+        for (signed int row = 0; row < TILE_HEIGHT_PIXELS_UNSCALED; ++row)
+        {
+            // pitch is negative for bitmaps stored bottom-up, so keep this arithmetic signed
+            const unsigned char *pixel = (const unsigned char *)region->data + ((pixelY + row) * region->pitch) + (pixelX * 4);
+            TMaskRow mask = 0;
+
+            for (signed int column = 0; column < TILE_WIDTH_PIXELS_UNSCALED; ++column, pixel += 4)
+            {
+                if (pixel[3] != 0)
+                    mask |= (TMaskRow(1) << column);
+            }
+
+            s_masks[(tileID * TILE_HEIGHT_PIXELS_UNSCALED) + row] = mask;
+        }
+    }
+
+    al_unlock_bitmap(atlas);
+
+    return true;
+}
+
+void SetCollisionMasks(const TMaskRow *masks, unsigned int tileCount)
+{
+    s_tileCount = tileCount;
+    s_masks.assign(masks, masks + (tileCount * TILE_HEIGHT_PIXELS_UNSCALED));
+}
+
+unsigned int CollisionMaskTileCount(void)
+{
+    return s_tileCount;
+}
+
+void DestroyCollisionMasks(void)
+{
+    s_masks.clear();
+    s_tileCount = 0;
+}
+
+const TMaskRow *CollisionMaskOfTile(unsigned int tileID)
+{
+    assert(tileID < s_tileCount);
+
+    return &s_masks[tileID * TILE_HEIGHT_PIXELS_UNSCALED];
+}
+
+// Pixel Perfect collision detector
+// originally from: https://www.allegro.cc/forums/thread/606547
+// now works on the precomputed collision masks instead of reading pixels back from the atlas
+bool ObjectCollide(unsigned int tileID1, signed int x1, signed int y1,
+                   unsigned int tileID2, signed int x2, signed int y2)
+{
+    // First we'll test if the bounding boxes overlap.
+    // If they don't overlap at all, there's no sense in checking further.
+    if ((x1 + TILE_WIDTH_PIXELS_UNSCALED  <= x2) ||
+        (x2 + TILE_WIDTH_PIXELS_UNSCALED  <= x1) ||
+        (y1 + TILE_HEIGHT_PIXELS_UNSCALED <= y2) ||
+        (y2 + TILE_HEIGHT_PIXELS_UNSCALED <= y1))
+        return false;
+
+    const TMaskRow *mask1 = CollisionMaskOfTile(tileID1);
+    const TMaskRow *mask2 = CollisionMaskOfTile(tileID2);
+
+    // horizontal distance from the first tile to the second. The bounding box test above guarantees
+    // it is less than a tile wide, so it is always a valid shift amount.
+    const signed int dx = x2 - x1;
+
+    // The bounding boxes overlap, so there's a potential collision.
+    // Only check the rows where they actually overlap.
+    const signed int over_top    = max(y1, y2);
+    const signed int over_bottom = min(y1, y2) + TILE_HEIGHT_PIXELS_UNSCALED;
+
+    for (signed int y = over_top; y < over_bottom; ++y)
+    {
+        const TMaskRow row1 = mask1[y - y1];
+        const TMaskRow row2 = mask2[y - y2];
+
+        // line both rows up on the same world columns, then any common bit is an overlapping pixel
+        if ((dx >= 0) ? ((row1 >> dx) & row2) : (row1 & (row2 >> -dx)))
+            return true;
+    }
+
+    return false;
+}
+
+// the columns of tiles a box covers, clamped to the level
+static void ColumnsCovered(double x, signed int width, signed int &first, signed int &last)
+{
+    first = max(0, (signed int)floor(x) / TILE_WIDTH_PIXELS_UNSCALED);
+    last  = min(GLOBALS::level.WidthTiles() - 1, ((signed int)ceil(x + width) - 1) / TILE_WIDTH_PIXELS_UNSCALED);
+}
+
+double DistanceToGround(double x, double y, signed int width, signed int height, double limit)
+{
+    const double bottom = y + height;
+
+    // from the first row whose top is at or below the box, to the last that's within limit of it
+    const signed int fromRow = ceil(bottom / TILE_HEIGHT_PIXELS_UNSCALED);
+    const signed int toRow = min(GLOBALS::level.HeightTiles() - 1, (signed int)floor((bottom + limit) / TILE_HEIGHT_PIXELS_UNSCALED));
+    signed int first, last, nearest = toRow + 1;
+
+    ColumnsCovered(x, width, first, last);
+    for (signed int column = first; column <= last; ++column)
+        nearest = min(nearest, GLOBALS::level.FirstGroundRow(column, fromRow, toRow));
+
+    // nearest is one past toRow if there was nothing; either the bottom of the level or beyond limit
+    return max(0.0, (nearest * TILE_HEIGHT_PIXELS_UNSCALED) - bottom);
+}
+
+double DistanceToCeiling(double x, double y, signed int width, double limit)
+{
+    // from the first row whose bottom is at or above the box, to the last that's within limit of it
+    const signed int fromRow = (signed int)floor(y / TILE_HEIGHT_PIXELS_UNSCALED) - 1;
+    const signed int toRow = max(0, (signed int)floor((y - limit) / TILE_HEIGHT_PIXELS_UNSCALED));
+    signed int first, last, nearest = toRow - 1;
+
+    ColumnsCovered(x, width, first, last);
+    for (signed int column = first; column <= last; ++column)
+        nearest = max(nearest, GLOBALS::level.FirstCeilingRow(column, fromRow, toRow));
+
+    // the bottom of row nearest, which is the top of the level when there was nothing at all
+    return max(0.0, y - ((nearest + 1) * TILE_HEIGHT_PIXELS_UNSCALED));
+}
+
+// true if any of the tiles in one column of the level, between rows first and last, has face solid
+static bool AnyFaceSolid(signed int column, signed int first, signed int last, unsigned int face)
+{
+    for (signed int row = first; row <= last; ++row)
+    {
+        if (GLOBALS::level.Tile(eLAYER_BOUNDS, column, row) & face)
+            return true;
+    }
+
+    return false;
+}
+
+TSweepResult SweepBox(double x, double y, signed int width, signed int height, double dx, double dy)
+{
+    assert((dx == 0.0) || (dy == 0.0));
+
+    TSweepResult result;
+    signed int column;
+
+    result.distance = dx + dy;
+    result.face = 0;
+
+    // up and down are straight out of the distance fields
+    if (dy > 0.0)
+    {
+        const double ground = DistanceToGround(x, y, width, height, dy);
+
+        if (ground < dy)
+        {
+            result.distance = ground;
+            result.face = SOLID_TOP;
+        }
+        return result;
+    }
+    else if (dy < 0.0)
+    {
+        const double ceiling = DistanceToCeiling(x, y, width, -dy);
+
+        if (ceiling < -dy)
+        {
+            result.distance = -ceiling;
+            result.face = SOLID_BOTTOM;
+        }
+        return result;
+    }
+
+    // the rows of tiles the box covers, which is all that can get in its way
+    const signed int firstRow = max(0                     , (signed int)floor(y) / TILE_HEIGHT_PIXELS_UNSCALED);
+    const signed int lastRow  = min(GLOBALS::level.HeightTiles() - 1, ((signed int)ceil(y + height) - 1) / TILE_HEIGHT_PIXELS_UNSCALED);
+
+    if (dx > 0.0)
+    {
+        // moving right runs into the left faces of tiles
+        const double leading = x + width;
+
+        // column is the first tile whose near face is at or ahead of the leading edge. Touching a face
+        // isn't a hit, only passing into it is.
+        for (column = ceil(leading / TILE_WIDTH_PIXELS_UNSCALED); (column * TILE_WIDTH_PIXELS_UNSCALED) < (leading + dx); ++column)
+        {
+            if ((column >= GLOBALS::level.WidthTiles()) || AnyFaceSolid(column, firstRow, lastRow, SOLID_LEFT))
+            {
+                result.distance = max(0.0, (column * TILE_WIDTH_PIXELS_UNSCALED) - leading);
+                result.face = SOLID_LEFT;
+                break;
+            }
+        }
+    }
+    else if (dx < 0.0)
+    {
+        // moving left runs into the right faces of tiles
+        const double leading = x;
+
+        for (column = (signed int)floor(leading / TILE_WIDTH_PIXELS_UNSCALED) - 1; ((column + 1) * TILE_WIDTH_PIXELS_UNSCALED) > (leading + dx); --column)
+        {
+            if ((column < 0) || AnyFaceSolid(column, firstRow, lastRow, SOLID_RIGHT))
+            {
+                result.distance = min(0.0, ((column + 1) * TILE_WIDTH_PIXELS_UNSCALED) - leading);
+                result.face = SOLID_RIGHT;
+                break;
+            }
+        }
+    }
+
+    return result;
+}
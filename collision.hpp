@@ -0,0 +1,53 @@
+#ifndef _COLLISION_HPP_
+#define _COLLISION_HPP_
+
+#include <stdint.h>
+
+#include "sam_shared.hpp"
+
+// One pixel row of a tile's collision mask. Bit 0 is the left-most pixel column,
+// a set bit means the pixel is not transparent.
+typedef uint32_t TMaskRow;
+
+// Build the per-tile collision masks from the (unscaled) tile atlas. Locks the atlas
+// exactly once, so call this at load time only - never from within the game loop.
+bool BuildCollisionMasks(ALLEGRO_BITMAP *atlas);
+void DestroyCollisionMasks(void);
+
+// instead of building them, e.g. when they were saved along with the atlas. tileCount tiles' worth of rows.
+void SetCollisionMasks(const TMaskRow *masks, unsigned int tileCount);
+unsigned int CollisionMaskTileCount(void);
+
+// TILE_HEIGHT_PIXELS_UNSCALED rows, top row first
+const TMaskRow *CollisionMaskOfTile(unsigned int tileID);
+
+// what happened to a box swept through the level's bounds
+typedef struct
+{
+    // How far the box got before touching a solid face, with the same sign as the move.
+    // The whole move if nothing was in the way.
+    double distance;
+
+    // the SOLID_ flag of the face that stopped it, or 0 if nothing did
+    unsigned int face;
+} TSweepResult;
+
+// How far a box (unscaled pixels, x/y is the top left corner) is above the nearest solid ground, or below
+// the nearest solid ceiling, in any column it covers. The top and bottom of the level count as solid.
+// Looks no further than limit pixels; if there's nothing nearer, the answer is limit or more.
+//
+// Each level chunk keeps, for every tile, where the next ground and ceiling is in the same column of
+// that chunk, so this is a lookup per chunk crossed rather than a search.
+double DistanceToGround(double x, double y, signed int width, signed int height, double limit);
+double DistanceToCeiling(double x, double y, signed int width, double limit);
+
+// Moves a box by dx or dy through the level's bounds grid and reports where it first touches a solid face.
+// Only one of dx and dy may be non-zero; every mover in the game travels along one axis at a time. The
+// edges of the level count as solid.
+//
+// Vertical moves are answered by DistanceToGround() and DistanceToCeiling(). Horizontal ones only check the tile boundaries
+// crossed, so the cost depends on the number of tiles moved through and not on the number of pixels.
+// Either way nothing can tunnel through a wall.
+TSweepResult SweepBox(double x, double y, signed int width, signed int height, double dx, double dy);
+
+#endif
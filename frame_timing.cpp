@@ -0,0 +1,199 @@
+#include <cstring>
+#include <algorithm>
+
+#include <allegro5/allegro.h>
+#include <allegro5/allegro_font.h>
+#include <allegro5/allegro_primitives.h>
+
+#include "frame_timing.hpp"
+
+const char *TFrameTimings::m_phaseNames[ePHASE_COUNT] =
+{
+    "events",
+    "player tick",
+    "interactives tick",
+    "collision",
+    "death check",
+    "background blit",
+    "sprite draw",
+    "status bar",
+    "present",
+    "flip",
+};
+
+TFrameTimings::TFrameTimings() :
+        m_visible(false),
+        m_frameStart(0.0),
+        m_nextFrame(0),
+        m_framesRecorded(0),
+        m_nextLatency(0),
+        m_latenciesRecorded(0)
+{
+    memset(m_phaseStart, 0, sizeof(m_phaseStart));
+    memset(m_phaseSeconds, 0, sizeof(m_phaseSeconds));
+}
+
+void TFrameTimings::Toggle()
+{
+    m_visible = !m_visible;
+
+    // start over, whatever is left from last time it was on is stale by now
+    m_nextFrame = 0;
+    m_framesRecorded = 0;
+    m_nextLatency = 0;
+    m_latenciesRecorded = 0;
+    memset(m_phaseSeconds, 0, sizeof(m_phaseSeconds));
+    m_frameStart = al_get_time();
+}
+
+void TFrameTimings::StartPhase(TFramePhase phase)
+{
+    if (m_visible)
+        m_phaseStart[phase] = al_get_time();
+}
+
+void TFrameTimings::StopPhase(TFramePhase phase)
+{
+    if (m_visible)
+        m_phaseSeconds[phase] += al_get_time() - m_phaseStart[phase];
+}
+
+void TFrameTimings::AddPhase(TFramePhase phase, double seconds)
+{
+    if (m_visible)
+        m_phaseSeconds[phase] += seconds;
+}
+
+void TFrameTimings::AddInputLatency(double seconds)
+{
+    if (!m_visible)
+        return;
+
+    m_latencyHistory[m_nextLatency] = seconds;
+
+    m_nextLatency = (m_nextLatency + 1) % WINDOW_FRAMES;
+    if (m_latenciesRecorded < WINDOW_FRAMES)
+        ++m_latenciesRecorded;
+}
+
+void TFrameTimings::StartFrame()
+{
+    if (m_visible)
+        m_frameStart = al_get_time();
+}
+
+void TFrameTimings::EndFrame()
+{
+    if (!m_visible)
+        return;
+
+    for (unsigned int phase = 0; phase < ePHASE_COUNT; ++phase)
+    {
+        m_phaseHistory[phase][m_nextFrame] = m_phaseSeconds[phase];
+        m_phaseSeconds[phase] = 0.0;
+    }
+    m_frameHistory[m_nextFrame] = al_get_time() - m_frameStart;
+
+    m_nextFrame = (m_nextFrame + 1) % WINDOW_FRAMES;
+    if (m_framesRecorded < WINDOW_FRAMES)
+        ++m_framesRecorded;
+}
+
+void TFrameTimings::Draw(const ALLEGRO_FONT *font, float x, float y) const
+{
+    const float LINE_HEIGHT = al_get_font_line_height(font) + 2;
+    const float WIDTH = 52 * al_get_text_width(font, "0");
+    const float HISTOGRAM_HEIGHT = 64;
+    const ALLEGRO_COLOR white = al_map_rgb(255,255,255);
+    float sorted[WINDOW_FRAMES];
+    unsigned int histogram[HISTOGRAM_BUCKETS];
+    unsigned int bucket, tallest = 1;
+
+    al_draw_filled_rectangle(x, y, x + WIDTH, y + (LINE_HEIGHT * (ePHASE_COUNT + 5)) + HISTOGRAM_HEIGHT + 10,
+                             al_map_rgba(0,0,0,192));
+
+    x += 4;
+    y += 4;
+
+    if (m_framesRecorded == 0)
+    {
+        al_draw_text(font, white, x, y, 0, "collecting frame timings...");
+        return;
+    }
+
+    al_draw_textf(font, white, x, y, 0, "last %3u frames    %8s %8s %8s", m_framesRecorded, "min ms", "avg ms", "p99 ms");
+    y += LINE_HEIGHT;
+
+    for (unsigned int phase = 0; phase <= ePHASE_COUNT; ++phase)
+    {
+        // the extra row at the end is the whole frame
+        const float *history = (phase < ePHASE_COUNT) ? m_phaseHistory[phase] : m_frameHistory;
+        double total = 0.0;
+
+        // only the first m_framesRecorded entries are filled in until the ring buffer has wrapped
+        std::copy(history, history + m_framesRecorded, sorted);
+        std::sort(sorted, sorted + m_framesRecorded);
+
+        for (unsigned int frame = 0; frame < m_framesRecorded; ++frame)
+            total += sorted[frame];
+
+        al_draw_textf(font, white, x, y, 0, "%-18s %8.3f %8.3f %8.3f",
+                      (phase < ePHASE_COUNT) ? m_phaseNames[phase] : "whole frame",
+                      sorted[0] * 1000.0,
+                      (total / m_framesRecorded) * 1000.0,
+                      sorted[((m_framesRecorded * 99) - 1) / 100] * 1000.0);
+        y += LINE_HEIGHT;
+    }
+
+    // over however many frames showed input, which may be none yet
+    if (m_latenciesRecorded)
+    {
+        double total = 0.0;
+
+        std::copy(m_latencyHistory, m_latencyHistory + m_latenciesRecorded, sorted);
+        std::sort(sorted, sorted + m_latenciesRecorded);
+
+        for (unsigned int sample = 0; sample < m_latenciesRecorded; ++sample)
+            total += sorted[sample];
+
+        al_draw_textf(font, white, x, y, 0, "%-18s %8.3f %8.3f %8.3f",
+                      "input to flip",
+                      sorted[0] * 1000.0,
+                      (total / m_latenciesRecorded) * 1000.0,
+                      sorted[((m_latenciesRecorded * 99) - 1) / 100] * 1000.0);
+    }
+    else
+        al_draw_textf(font, white, x, y, 0, "%-18s %8s %8s %8s", "input to flip", "-", "-", "-");
+    y += LINE_HEIGHT;
+
+    // histogram of whole frame times
+    memset(histogram, 0, sizeof(histogram));
+    for (unsigned int frame = 0; frame < m_framesRecorded; ++frame)
+    {
+        bucket = std::min<unsigned int>(m_frameHistory[frame] * 1000.0, HISTOGRAM_BUCKETS - 1);
+        ++histogram[bucket];
+    }
+    for (bucket = 0; bucket < HISTOGRAM_BUCKETS; ++bucket)
+        tallest = std::max(tallest, histogram[bucket]);
+
+    y += LINE_HEIGHT;
+    const float barWidth = (WIDTH - 8) / HISTOGRAM_BUCKETS;
+    for (bucket = 0; bucket < HISTOGRAM_BUCKETS; ++bucket)
+    {
+        const float barHeight = (HISTOGRAM_HEIGHT * histogram[bucket]) / tallest;
+
+        // green fits a 60Hz frame, yellow a 30Hz one, red is a visible hitch
+        const ALLEGRO_COLOR colour = (bucket < 16) ? al_map_rgb(0,200,0) :
+                                     (bucket < 33) ? al_map_rgb(220,220,0) :
+                                                     al_map_rgb(220,0,0);
+
+        if (histogram[bucket])
+            al_draw_filled_rectangle(x + (bucket * barWidth), y + HISTOGRAM_HEIGHT - barHeight,
+                                     x + ((bucket + 1) * barWidth) - 1, y + HISTOGRAM_HEIGHT,
+                                     colour);
+    }
+
+    y += HISTOGRAM_HEIGHT + 2;
+    al_draw_text(font, white, x, y, 0, "0 ms");
+    al_draw_textf(font, white, x + WIDTH - 8, y, ALLEGRO_ALIGN_RIGHT, "%u+ ms", HISTOGRAM_BUCKETS - 1);
+}
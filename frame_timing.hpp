@@ -0,0 +1,84 @@
+#ifndef _FRAME_TIMING_HPP_
+#define _FRAME_TIMING_HPP_
+
+#include <atomic>
+
+#include <allegro5/allegro.h>
+#include <allegro5/allegro_font.h>
+
+// the parts of a frame that get timed separately
+typedef enum
+{
+    ePHASE_EVENTS,
+    ePHASE_PLAYER_TICK,
+    ePHASE_INTERACTIVES_TICK,
+    ePHASE_COLLISION,
+    ePHASE_DEATH_CHECK,
+    ePHASE_BACKGROUND,
+    ePHASE_SPRITES,
+    ePHASE_STATUS_BAR,
+    ePHASE_PRESENT,
+    ePHASE_FLIP,
+
+    ePHASE_COUNT // ALWAYS LAST - is the number of phases in the enum
+} TFramePhase;
+
+// Times each phase of the last WINDOW_FRAMES frames, for an on-screen overlay showing rolling
+// min/avg/p99 per phase and a histogram of whole frame times. Likewise for how long input took to
+// reach the screen, over the last WINDOW_FRAMES frames that showed any.
+//
+// Nothing is timed while the overlay is hidden, so it costs nothing until it's turned on.
+class TFrameTimings
+{
+public:
+    TFrameTimings();
+
+    void Toggle();
+    bool Visible() const { return m_visible; }; // from any thread
+
+    // A phase may be started and stopped more than once within a frame (e.g. once per simulation tick),
+    // its times are added up.
+    void StartPhase(TFramePhase phase);
+    void StopPhase(TFramePhase phase);
+
+    // for a phase timed on some other thread (e.g. the simulation's), added to the current frame
+    void AddPhase(TFramePhase phase, double seconds);
+
+    // from the oldest input event this frame is the first to show, to the frame's flip
+    void AddInputLatency(double seconds);
+
+    void StartFrame();
+    void EndFrame();
+
+    // draws the overlay with its top left corner at x, y (display pixels)
+    void Draw(const ALLEGRO_FONT *font, float x, float y) const;
+
+    enum
+    {
+        WINDOW_FRAMES = 240, // a few seconds worth
+
+        HISTOGRAM_BUCKETS = 34, // one per millisecond, the last one holding every frame of 33ms or more
+    };
+
+private:
+    std::atomic<bool> m_visible;
+
+    double m_frameStart;
+    double m_phaseStart[ePHASE_COUNT];
+    double m_phaseSeconds[ePHASE_COUNT];
+
+    // ring buffers of the most recent frames, in seconds
+    float m_phaseHistory[ePHASE_COUNT][WINDOW_FRAMES];
+    float m_frameHistory[WINDOW_FRAMES];
+    unsigned int m_nextFrame;
+    unsigned int m_framesRecorded;
+
+    // likewise, but only advancing on frames with input
+    float m_latencyHistory[WINDOW_FRAMES];
+    unsigned int m_nextLatency;
+    unsigned int m_latenciesRecorded;
+
+    static const char *m_phaseNames[ePHASE_COUNT];
+};
+
+#endif
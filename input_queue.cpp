@@ -0,0 +1,54 @@
+#include <atomic>
+
+#include "sam_shared.hpp"
+#include "input_queue.hpp"
+
+TInputQueue::TInputQueue() :
+        m_held(0),
+        m_taken(0),
+        m_queueHead(0),
+        m_queueTail(0)
+{
+}
+
+void TInputQueue::Reset()
+{
+    m_held = 0;
+    m_taken = 0;
+    m_queueHead = m_queueTail = 0;
+}
+
+bool TInputQueue::Push(double time, TActionSet actions)
+{
+    const unsigned int tail = m_queueTail.load(std::memory_order_relaxed);
+
+    if (tail - m_queueHead.load(std::memory_order_acquire) >= QUEUE_SLOTS)
+        return false;
+
+    m_queue[tail & (QUEUE_SLOTS - 1)].time = time;
+    m_queue[tail & (QUEUE_SLOTS - 1)].actions = actions;
+    m_queueTail.store(tail + 1, std::memory_order_release);
+
+    return true;
+}
+
+TActionSet TInputQueue::ActionsAt(double time)
+{
+    const unsigned int tail = m_queueTail.load(std::memory_order_acquire);
+    unsigned int head = m_queueHead.load(std::memory_order_relaxed);
+    TActionSet pressed = 0;
+
+    // anything after time is left for a later tick
+    for (; (head != tail) && (m_queue[head & (QUEUE_SLOTS - 1)].time <= time); ++head)
+    {
+        const TActionSet actions = m_queue[head & (QUEUE_SLOTS - 1)].actions;
+
+        pressed |= actions & ~m_held;
+        m_held = actions;
+        ++m_taken;
+    }
+
+    m_queueHead.store(head, std::memory_order_release);
+
+    return m_held | pressed;
+}
@@ -0,0 +1,55 @@
+#ifndef _INPUT_QUEUE_HPP_
+#define _INPUT_QUEUE_HPP_
+
+#include <atomic>
+
+#include "sam_shared.hpp"
+
+// Passes the actions the keyboard asks for from the display's thread, which reads the events, to the
+// simulation's, stamped with when each key event happened. Each tick then acts on the keys as they were
+// at the time it was due, rather than whenever the display got round to reading them, and a key that was
+// pressed and let go again between two ticks still counts for the second one.
+//
+// One thread pushes and one thread takes, through a fixed-size lock-free queue.
+class TInputQueue
+{
+public:
+    TInputQueue();
+
+    // nothing held and nothing queued. Only while neither thread is using the queue.
+    void Reset();
+
+    // Never blocks. actions is everything held as of time (as in al_get_time()). False if the queue was
+    // full, in which case the change is dropped - the next one has the whole of what's held anyway.
+    bool Push(double time, TActionSet actions);
+
+    // Takes every change up to time. Returns what's held as of then, plus whatever was pressed along the way.
+    TActionSet ActionsAt(double time);
+
+    // how many changes ActionsAt() has taken since the last Reset(). Only from the thread that takes.
+    unsigned int Taken() const { return m_taken; };
+
+    enum
+    {
+        QUEUE_SLOTS = 256 // must be a power of 2
+    };
+
+private:
+    typedef struct
+    {
+        double time;
+        TActionSet actions;
+    } TChange;
+
+    // only touched by the taking thread
+    TActionSet m_held;
+    unsigned int m_taken;
+
+    // Written only by Push() and read only by ActionsAt(): a change is in the queue once m_queueTail has
+    // moved past it, and its slot is free again once m_queueHead has.
+    TChange m_queue[QUEUE_SLOTS];
+    std::atomic<unsigned int> m_queueHead;
+    std::atomic<unsigned int> m_queueTail;
+};
+
+#endif
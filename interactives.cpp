@@ -1,11 +1,19 @@
 #include <cassert>
 #include <cstdio>
 #include <cmath>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <functional>
 
 #include "sam_shared.hpp"
 #include "interactives.hpp"
+#include "collision.hpp"
+#include "trace.hpp"
+#include "sprites.hpp"
+#include "sound.hpp"
 
-#include "level1.h"
+#include "level.hpp"
 
 const unsigned int TPlayer::frames[eNUM_PLAYER_ANIMATIONS][eFRAMES_PER_ANIMATION] =
 {
@@ -286,7 +294,8 @@ void TPlayer::FireBullet()
 
 	signed int y = m_y + (TILE_HEIGHT_PIXELS_UNSCALED / 6);
 
-	GLOBALS::interactives.push_back(new TBullet(x, y, m_facing));
+	TBullet::Spawn(GLOBALS::interactives, x, y, m_facing);
+	++m_bulletsFlying;
 }
 
 void TPlayer::BulletDied()
@@ -305,7 +314,8 @@ void TPlayer::StartJumping()
 void TPlayer::StartWalking()
 {
 	m_xVelocityPerSecond = MAX_X_VELOCITY_PER_SECOND;
-	m_x = trunc(m_x);
+	// x stays fractional. Walking drops back to standing at the end of every tick, so truncating
+	// here would throw away each tick's sub-pixel step at high tick rates.
 	m_y = trunc(m_y);
 }
 
@@ -313,7 +323,6 @@ void TPlayer::StartStanding()
 {
 	m_xVelocityPerSecond = 0;
 	m_yVelocityPerSecond = 0;
-	m_x = trunc(m_x);
 	m_y = trunc(m_y);
 }
 
@@ -322,39 +331,20 @@ void TPlayer::MoveHorizontal(double secondsThisTick)
 	// IMPORTANT: ALL MOVEMENTS ARE PERFORMED IN THE UNSCALED PIXEL WORLD
 
 	double xVelocityThisTick = secondsThisTick * m_xVelocityPerSecond;
-	int tileX, tileYtop, tileYbottom;
-
-	// tileYtop is the Y row of the tiles where the player's head is
-	tileYtop =     m_y                                    / TILE_HEIGHT_PIXELS_UNSCALED;
-	// tileYbottom is the Y row of the tiles where the player's feet are
-	tileYbottom = (m_y + TILE_HEIGHT_PIXELS_UNSCALED - 1) / TILE_HEIGHT_PIXELS_UNSCALED;
 
 	// getting less than one tick per second? something's gone very wrong or player's
 	// computer is way too slow.
 	assert(secondsThisTick <= 1.0);
 
 	if (m_facing == eFACING_LEFT)
-	{
-		// tileX is the X column of the tiles into which the player wants to move
-		tileX = max(0.0                            , m_x - xVelocityThisTick              ) / TILE_WIDTH_PIXELS_UNSCALED;
+		xVelocityThisTick = -xVelocityThisTick;
 
-		if (!(level1MapData.bounds[tileYtop    * LEVEL_WIDTH_TILES + tileX] & SOLID_RIGHT) &&
-			!(level1MapData.bounds[tileYbottom * LEVEL_WIDTH_TILES + tileX] & SOLID_RIGHT))
-			m_x -= xVelocityThisTick;
-		else
-			m_xVelocityPerSecond = 0;
-	}
-	else // moving right
-	{
-		// tileX is the X column of the tiles into which the player wants to move
-		tileX = min(LEVEL_WIDTH_PIXELS_UNSCALED - 1, m_x + xVelocityThisTick + DrawWidth()) / TILE_WIDTH_PIXELS_UNSCALED;
+	// go as far as the map allows, and stop dead against anything solid
+	const TSweepResult hit = SweepBox(m_x, m_y, DrawWidth(), TILE_HEIGHT_PIXELS_UNSCALED, xVelocityThisTick, 0.0);
 
-		if (!(level1MapData.bounds[tileYtop    * LEVEL_WIDTH_TILES + tileX] & SOLID_LEFT) &&
-			!(level1MapData.bounds[tileYbottom * LEVEL_WIDTH_TILES + tileX] & SOLID_LEFT))
-			m_x += xVelocityThisTick;
-		else
-			m_xVelocityPerSecond = 0;
-	}
+	m_x += hit.distance;
+	if (hit.face)
+		m_xVelocityPerSecond = 0;
 }
 
 void TPlayer::MoveVertical(double secondsThisTick)
@@ -364,13 +354,22 @@ void TPlayer::MoveVertical(double secondsThisTick)
 	// computer is way too slow.
 	assert(secondsThisTick <= 1.0);
 
+	// Find out how far the player really gets in a single sweep. This is also the exact
+	// distance to a ceiling or to the ground, whichever is in the way.
+	const TSweepResult hit = SweepBox(m_x, m_y, DrawWidth(), TILE_HEIGHT_PIXELS_UNSCALED, 0.0, yVelocityThisTick);
+
+	m_y += hit.distance;
+
 	// player is either jumping or falling
     if (m_yVelocityPerSecond < 0) // negative Y velocity meaning moving upward.
     {
-		if (CanMoveVerticalBy(yVelocityThisTick))
+		if (hit.face) // solid blocks above, bumped into them
+		{
+			TRACE_DEBUG("MoveVertical hit ceiling", "y", m_y, "yVelocity", m_yVelocityPerSecond);
+			ChangeToState(eSTATE_FALLING);
+		}
+		else
 		{
-			m_y += yVelocityThisTick;
-
 			// velocity starts out at max negative and slows down (by getting closer to zero) as jump progresses
 			// to form something slightly resembling parabolic motion
 			m_yVelocityPerSecond += ((ACCELERATION_PER_SECOND / 2) * secondsThisTick);
@@ -378,81 +377,29 @@ void TPlayer::MoveVertical(double secondsThisTick)
 			if (m_yVelocityPerSecond >= 0) // positive velocity means falling
 				ChangeToState(eSTATE_FALLING);
 		}
-		else // solid blocks somewhere above
-		{
-			// determine how far we actually can move
-			double canMove;
-			for (canMove = 1.0 + yVelocityThisTick;
-				 CanMoveVerticalBy(canMove) && (canMove <= 0);
-				 ++canMove)
-				; // no more work to do. canMove determines how far player can move.
-			if (canMove < 0)
-				m_y += canMove;
-
-			ChangeToState(eSTATE_FALLING);
-		}
     }
     else // apply gravity. positive Y velocity means falling. (may be falling or firing)
     {
-		printf("\nDBUG: MoveVertical Path 2");
-		if (CanMoveVerticalBy(yVelocityThisTick+TILE_HEIGHT_PIXELS_UNSCALED))
-			// need to account for player height when trying to move downward since
-			// player's m_y is the top of the head and feet are what touch the ground.
-		{
-			printf("\nDBUG: MoveVertical Path 2a");
-			m_y += yVelocityThisTick;
-
-			if (OnSolidGround()) // might be now that we fell down some
-	        {
-				printf("\nDBUG: MoveVertical Path 2a1");
-
-				m_yVelocityPerSecond = 0;
-	    		if (m_xVelocityPerSecond != 0)
-	    		{
-					printf("\nDBUG: MoveVertical Path 2a1a");
-	    			ChangeToState(eSTATE_WALKING);
-	    		}
-	    		else
-	    		{
-					printf("\nDBUG: MoveVertical Path 2a1b");
-	    			ChangeToState(eSTATE_STANDING);
-	    		}
-	        }
-	        else // still falling
-	        {
-				printf("\nDBUG: MoveVertical Path 2a2");
-
-				// player falls faster the farther they fall (up to a terminal velocity)
-	    		m_yVelocityPerSecond += (ACCELERATION_PER_SECOND * secondsThisTick);
-	            if (m_yVelocityPerSecond > MAX_Y_VELOCITY_PER_SECOND)
-	                m_yVelocityPerSecond = MAX_Y_VELOCITY_PER_SECOND;
-	        }
-		}
-		else // ground is closer than our present velocity. find out where it is and stop there
-		{
-			printf("\nDBUG: MoveVertical Path 2b");
-
-			m_y = trunc(m_y);
-			double canMove;
-			for (canMove = TILE_HEIGHT_PIXELS_UNSCALED; // one pixel below current position
-				 CanMoveVerticalBy(canMove);            // can player move that far?
-			     ++canMove)                             // try even a bit further
-				;
-
-			m_y = trunc(m_y + (canMove - TILE_HEIGHT_PIXELS_UNSCALED));
+		// landed on the map, or on something that isn't part of it (e.g. a pushable)
+		if (hit.face || OnSolidGround())
+        {
+			TRACE_DEBUG("MoveVertical landed", "y", m_y, "yVelocity", m_yVelocityPerSecond);
 
-        	m_yVelocityPerSecond = 0;
+			m_yVelocityPerSecond = 0;
     		if (m_xVelocityPerSecond != 0)
-    		{
-				printf("\nDBUG: MoveVertical Path 2b1");
     			ChangeToState(eSTATE_WALKING);
-    		}
     		else
-    		{
-				printf("\nDBUG: MoveVertical Path 2b2");
     			ChangeToState(eSTATE_STANDING);
-    		}
-		}
+        }
+        else // still falling
+        {
+			TRACE_DEBUG("MoveVertical falling", "y", m_y, "yVelocity", m_yVelocityPerSecond);
+
+			// player falls faster the farther they fall (up to a terminal velocity)
+    		m_yVelocityPerSecond += (ACCELERATION_PER_SECOND * secondsThisTick);
+            if (m_yVelocityPerSecond > MAX_Y_VELOCITY_PER_SECOND)
+                m_yVelocityPerSecond = MAX_Y_VELOCITY_PER_SECOND;
+        }
     }
 }
 
@@ -499,6 +446,7 @@ void TPlayer::Reset(signed int x, signed int y)
 
     m_x = x;
     m_y = y;
+    StorePreviousPosition();
 
     // unscaled pixels
     m_xVelocityPerSecond = 0.0;
@@ -509,176 +457,352 @@ void TPlayer::Reset(signed int x, signed int y)
 }
 
 
-bool TGlasses::CollidedWith(TObject &obj)
+unsigned int TInteractivePool::Append(unsigned int newTileID, double newX, double newY, signed int newDrawWidth)
 {
-    if (&obj == &GLOBALS::player)
-    {
-        const unsigned int atlasWidth_tiles = al_get_bitmap_width(GLOBALS::tileAtlas_unscaled) / TILE_WIDTH_PIXELS_UNSCALED;
-        unsigned int tileY, tileX;
-        signed int tileID, tileIndex;
+    x.push_back(newX);
+    y.push_back(newY);
+    previousX.push_back(newX);
+    previousY.push_back(newY);
+    xVelocityPerSecond.push_back(0.0);
 
-        al_set_target_bitmap(GLOBALS::background_scaled);
+    tileID.push_back(newTileID);
+    drawWidth.push_back(newDrawWidth);
 
-        // turn on the invisible platforms
-        for (tileIndex = 0; tileIndex < (LEVEL_HEIGHT_TILES * LEVEL_WIDTH_TILES); ++tileIndex)
-        {
-            if (level1MapData.codes[tileIndex] == eCODE_INVISIBLE_PLATFORM)
-            {
-                level1MapData.codes[tileIndex] = 0;
-
-                tileID = 53;
-
-                level1MapData.bounds[tileIndex] = SOLID_TOP;
-                level1MapData.midTiles[tileIndex] = tileID;
-
-                tileY = tileIndex / LEVEL_WIDTH_TILES;
-                tileX = tileIndex % LEVEL_WIDTH_TILES;
-                al_draw_scaled_bitmap(GLOBALS::tileAtlas_unscaled,
-                                      (tileID % atlasWidth_tiles) * TILE_WIDTH_PIXELS_UNSCALED, (tileID / atlasWidth_tiles) * TILE_HEIGHT_PIXELS_UNSCALED,
-                                      TILE_WIDTH_PIXELS_UNSCALED, TILE_HEIGHT_PIXELS_UNSCALED,
-                                      (TILE_WIDTH_PIXELS_UNSCALED * SCALE_FACTOR) * tileX, (TILE_HEIGHT_PIXELS_UNSCALED * SCALE_FACTOR) * tileY,
-                                      TILE_WIDTH_PIXELS_UNSCALED * SCALE_FACTOR, TILE_HEIGHT_PIXELS_UNSCALED * SCALE_FACTOR,
-                                      0);
-            }
-        }
-        // paint over glasses graphic in background image
-        tileY = m_y/TILE_HEIGHT_PIXELS_UNSCALED;
-        tileX = m_x/TILE_WIDTH_PIXELS_UNSCALED;
-
-/*
-        tileID = level1MapData.backTiles[(tileY*LEVEL_WIDTH_TILES)+tileX];
-
-        al_draw_scaled_bitmap(GLOBALS::tileAtlas_unscaled,
-                              (tileID % atlasWidth_tiles) * TILE_WIDTH_PIXELS_UNSCALED, (tileID / atlasWidth_tiles) * TILE_HEIGHT_PIXELS_UNSCALED,
-                              TILE_WIDTH_PIXELS_UNSCALED, TILE_HEIGHT_PIXELS_UNSCALED,
-                              (TILE_WIDTH_PIXELS_UNSCALED * SCALE_FACTOR) * tileX, (TILE_HEIGHT_PIXELS_UNSCALED * SCALE_FACTOR) * tileY,
-                              TILE_WIDTH_PIXELS_UNSCALED * SCALE_FACTOR, TILE_HEIGHT_PIXELS_UNSCALED * SCALE_FACTOR,
-                              0);
-*/
-        return true;
-    }
+    frameIndex.push_back(0);
+    secondsSinceFrameChange.push_back(0.0);
 
-    return false;
+    timesShot.push_back(0);
+
+    return Count() - 1;
 }
 
+unsigned int TInteractivePool::RemoveAt(unsigned int index)
+{
+    const unsigned int last = Count() - 1;
+
+    assert(index <= last);
+
+    x[index]                       = x[last];
+    y[index]                       = y[last];
+    previousX[index]               = previousX[last];
+    previousY[index]               = previousY[last];
+    xVelocityPerSecond[index]      = xVelocityPerSecond[last];
+    tileID[index]                  = tileID[last];
+    drawWidth[index]               = drawWidth[last];
+    frameIndex[index]              = frameIndex[last];
+    secondsSinceFrameChange[index] = secondsSinceFrameChange[last];
+    timesShot[index]               = timesShot[last];
+
+    x.pop_back();
+    y.pop_back();
+    previousX.pop_back();
+    previousY.pop_back();
+    xVelocityPerSecond.pop_back();
+    tileID.pop_back();
+    drawWidth.pop_back();
+    frameIndex.pop_back();
+    secondsSinceFrameChange.pop_back();
+    timesShot.pop_back();
+
+    return last;
+}
 
+void TInteractivePool::Clear()
+{
+    x.clear();
+    y.clear();
+    previousX.clear();
+    previousY.clear();
+    xVelocityPerSecond.clear();
+    tileID.clear();
+    drawWidth.clear();
+    frameIndex.clear();
+    secondsSinceFrameChange.clear();
+    timesShot.clear();
+}
 
-const unsigned int TSatelliteDish::frames[eFRAMES_PER_ANIMATION] = {357, 358, 357, 359}; /* center, right, center, left */
-const   signed int TSatelliteDish::widths[eFRAMES_PER_ANIMATION] = {TILE_WIDTH_PIXELS_UNSCALED, TILE_WIDTH_PIXELS_UNSCALED, TILE_WIDTH_PIXELS_UNSCALED, TILE_WIDTH_PIXELS_UNSCALED};
 
-void TSatelliteDish::Tick(double delta_seconds)
+void TInteractives::Reset(signed int levelWidthPixels, signed int levelHeightPixels)
 {
-	m_seconds_since_last_frame_change += delta_seconds;
+    for (unsigned int kind = 0; kind < eINTERACTIVE_KIND_COUNT; ++kind)
+        m_pools[kind].Clear();
 
-	if (m_seconds_since_last_frame_change >= 0.33)
-	{
-		m_frameIndex = (m_frameIndex + 1) % eFRAMES_PER_ANIMATION;
-		m_seconds_since_last_frame_change = 0.0;
-	}
+    m_grid.Reset(levelWidthPixels, levelHeightPixels);
+    m_awake.clear();
 }
 
-bool TSatelliteDish::CollidedWith(TObject &obj)
+void TInteractives::Activate(double x, double y)
 {
-	/*
-	if (obj == player's bullet)
-		++m_timeShot;
+    m_awake.clear();
+    m_grid.Query(x - (ACTIVE_WIDTH_PIXELS / 2), y - (ACTIVE_HEIGHT_PIXELS / 2), ACTIVE_WIDTH_PIXELS, ACTIVE_HEIGHT_PIXELS, m_awake);
 
-		if (m_timesShot >= hit points)
-			remove from level
-			give player points
-			record that dish is destroyed, so player is allowed to exit
-			return true;
-	*/
+    // by kind, then by index, so the passes over them walk each pool's arrays front to back
+    std::sort(m_awake.begin(), m_awake.end());
 
-	return false;
+    // bullets are looked after separately, all of them. They're the last kind, so sort to the end
+    m_awake.erase(std::lower_bound(m_awake.begin(), m_awake.end(), MakeInteractiveRef(eINTERACTIVE_BULLET, 0)), m_awake.end());
 }
 
+TInteractiveRef TInteractives::Spawn(TInteractiveKind kind, unsigned int tileID, signed int x, signed int y, signed int drawWidth)
+{
+    assert(kind < eINTERACTIVE_KIND_COUNT);
+
+    const TInteractiveRef ref = MakeInteractiveRef(kind, m_pools[kind].Append(tileID, x, y, drawWidth));
+
+    m_grid.Insert(ref, x, y);
 
-unsigned int TSatelliteDish::TileID() const
+    return ref;
+}
+
+void TInteractives::Destroy(std::vector<TInteractiveRef> &doomed)
 {
-    return frames[m_frameIndex];
+    // Removing moves the last interactive of the pool into the freed slot. Going from the highest
+    // index of each kind down to the lowest means nothing that still has to be removed ever gets moved.
+    std::sort(doomed.begin(), doomed.end(), std::greater<TInteractiveRef>());
+    if (!doomed.empty())
+        m_awake.clear();
+
+    doomed.erase(std::unique(doomed.begin(), doomed.end()), doomed.end());
+
+    for (std::vector<TInteractiveRef>::iterator it = doomed.begin(); it != doomed.end(); ++it)
+    {
+        const TInteractiveKind kind = KindOfRef(*it);
+        const unsigned int index = IndexOfRef(*it);
+
+        m_grid.Remove(*it);
+
+        const unsigned int moved = m_pools[kind].RemoveAt(index);
+        if (moved != index)
+            m_grid.Rekey(MakeInteractiveRef(kind, moved), *it);
+
+        if (kind == eINTERACTIVE_BULLET)
+            GLOBALS::player.BulletDied();
+    }
 }
 
-signed int TSatelliteDish::DrawWidth() const
+void TInteractives::Moved(TInteractiveRef ref)
 {
-    return widths[m_frameIndex];
+    m_grid.Moved(ref, X(ref), Y(ref));
 }
 
+void TInteractives::Tick(double delta_seconds)
+{
+    // glasses, ammo and pushables just sit there until touched, so only these two kinds have any work to do
+    for (std::vector<TInteractiveRef>::const_iterator it = m_awake.begin(); it != m_awake.end(); ++it)
+    {
+        if (KindOfRef(*it) == eINTERACTIVE_SATELLITE_DISH)
+            TSatelliteDish::Tick(m_pools[eINTERACTIVE_SATELLITE_DISH], IndexOfRef(*it), delta_seconds);
+    }
+
+    // (kept between ticks so it doesn't have to be reallocated every time)
+    static std::vector<TInteractiveRef> stopped;
+    TInteractivePool &bullets = m_pools[eINTERACTIVE_BULLET];
+
+    stopped.clear();
+    TBullet::Tick(bullets, delta_seconds, stopped);
+    for (unsigned int index = 0; index < bullets.Count(); ++index)
+        m_grid.Moved(MakeInteractiveRef(eINTERACTIVE_BULLET, index), bullets.x[index], bullets.y[index]);
 
+    // bullets that hit a wall are done
+    Destroy(stopped);
+}
 
-bool TAmmo::CollidedWith(TObject &obj)
+void TInteractives::StorePreviousPositions()
 {
-    if (&obj == &GLOBALS::player)
+    // anything asleep hasn't moved since it was last awake, and can't be seen
+    for (std::vector<TInteractiveRef>::const_iterator it = m_awake.begin(); it != m_awake.end(); ++it)
     {
-        GLOBALS::player.AddAmmo(5); // 5 = number of shots awarded for each ammo collected
+        TInteractivePool &pool = m_pools[KindOfRef(*it)];
+        const unsigned int index = IndexOfRef(*it);
+
+        pool.previousX[index] = pool.x[index];
+        pool.previousY[index] = pool.y[index];
+    }
+
+    m_pools[eINTERACTIVE_BULLET].previousX = m_pools[eINTERACTIVE_BULLET].x;
+    m_pools[eINTERACTIVE_BULLET].previousY = m_pools[eINTERACTIVE_BULLET].y;
+}
+
+double TInteractives::InterpolatedX(TInteractiveRef ref, double alpha) const
+{
+    const TInteractivePool &pool = m_pools[KindOfRef(ref)];
+    const unsigned int index = IndexOfRef(ref);
+
+    return pool.previousX[index] + ((pool.x[index] - pool.previousX[index]) * alpha);
+}
+
+double TInteractives::InterpolatedY(TInteractiveRef ref, double alpha) const
+{
+    const TInteractivePool &pool = m_pools[KindOfRef(ref)];
+    const unsigned int index = IndexOfRef(ref);
+
+    return pool.previousY[index] + ((pool.y[index] - pool.previousY[index]) * alpha);
+}
+
+bool TInteractives::PlayerTouched(TInteractiveRef ref)
+{
+    const TInteractiveKind kind = KindOfRef(ref);
+    const unsigned int index = IndexOfRef(ref);
+    bool remove = false;
+
+    switch (kind)
+    {
+    case eINTERACTIVE_GLASSES:
+        remove = TGlasses::PlayerTouched(m_pools[kind], index);
+        break;
+
+    case eINTERACTIVE_AMMO:
+        remove = TAmmo::PlayerTouched(m_pools[kind], index);
+        break;
+
+    case eINTERACTIVE_PUSHABLE:
+        remove = TPushable::PlayerTouched(m_pools[kind], index);
+        Moved(ref);
+        break;
+
+    case eINTERACTIVE_SATELLITE_DISH:
+        break;
+
+    case eINTERACTIVE_BULLET:
+        // bullets are always removed when they collide with something, regardless of what it was.
+        remove = true;
+        break;
+
+    default:
+        assert(0);
+    }
+
+    return remove;
+}
+
+bool TInteractives::ShotHit(TInteractiveRef ref)
+{
+    const TInteractiveKind kind = KindOfRef(ref);
+
+    switch (kind)
+    {
+    case eINTERACTIVE_SATELLITE_DISH:
+        return TSatelliteDish::ShotHit(m_pools[kind], IndexOfRef(ref));
+
+    case eINTERACTIVE_BULLET:
         return true;
+
+    default:
+        // nothing else cares about being shot
+        return false;
     }
+}
 
-    return false;
+
+bool TGlasses::PlayerTouched(TInteractivePool __attribute__ ((unused)) &pool, unsigned int __attribute__ ((unused)) index)
+{
+    // turn on the invisible platforms, wherever they are in the level
+    // (the background catches up with them at the end of the tick)
+    GLOBALS::level.RevealInvisiblePlatforms(PLATFORM_TILE_ID);
+
+    // picked up
+    return true;
 }
 
 
-TPushable::TPushable(unsigned int tileID, signed int x, signed int y) : TObject(tileID, x, y)
+
+const unsigned int TSatelliteDish::frames[eFRAMES_PER_ANIMATION] = {357, 358, 357, 359}; /* center, right, center, left */
+
+signed int TSatelliteDish::Width(unsigned int frameIndex)
 {
+    return GLOBALS::sprites.Frame(frames[frameIndex]).Right();
 }
 
-bool TPushable::CollidedWith(TObject &obj)
+void TSatelliteDish::Tick(TInteractivePool &pool, unsigned int i, double delta_seconds)
 {
-    int oldX = m_x;
-    int oldY = m_y;
-	int tileX = oldX / TILE_WIDTH_PIXELS_UNSCALED;
-    int tileXright = (oldX + DrawWidth() - 1) / TILE_WIDTH_PIXELS_UNSCALED;
-    int tileY = oldY / TILE_HEIGHT_PIXELS_UNSCALED;
+    pool.secondsSinceFrameChange[i] += delta_seconds;
 
-    if (&obj == &GLOBALS::player)
+    if (pool.secondsSinceFrameChange[i] >= 0.33)
     {
-        if ((GLOBALS::player.m_x < m_x) && (GLOBALS::player.Facing() == eFACING_RIGHT)) // player is on left, trying to push right
-        {
-        	tileXright = (oldX + DrawWidth()) / TILE_WIDTH_PIXELS_UNSCALED;
-        	if (!(level1MapData.bounds[tileY * LEVEL_WIDTH_TILES + tileXright] & SOLID_LEFT))
-        	{
-        		m_x = GLOBALS::player.m_x + GLOBALS::player.DrawWidth();
-        	}
-        }
-        else if ((GLOBALS::player.m_x > m_x) && (GLOBALS::player.Facing() == eFACING_LEFT)) // player is on right, trying to push left
-        {
-        	tileX = (oldX-1) / TILE_WIDTH_PIXELS_UNSCALED;
-            if (!(level1MapData.bounds[tileY * LEVEL_WIDTH_TILES + tileX] & SOLID_RIGHT))
-            {
-            	m_x = GLOBALS::player.m_x - DrawWidth();
-            }
-        }
+        pool.frameIndex[i] = (pool.frameIndex[i] + 1) % eFRAMES_PER_ANIMATION;
+        pool.secondsSinceFrameChange[i] = 0.0;
+
+        pool.tileID[i]    = frames[pool.frameIndex[i]];
+        pool.drawWidth[i] = Width(pool.frameIndex[i]);
     }
+}
+
+bool TSatelliteDish::ShotHit(TInteractivePool &pool, unsigned int index)
+{
+    ++pool.timesShot[index];
+    GLOBALS::sound.Post(eSOUND_DISH_HIT);
+
+    /*
+    if (m_timesShot >= hit points)
+        remove from level
+        give player points
+        record that dish is destroyed, so player is allowed to exit
+        return true;
+    */
 
-    // always returns false because pushables are never removed, even when touched
     return false;
 }
 
 
-TBullet::TBullet(signed int x, signed int y, TFacing directionMoving) : TObject(280, x, y), m_xReal(x), m_xVelocity(TILE_WIDTH_PIXELS_UNSCALED * 3)
+
+bool TAmmo::PlayerTouched(TInteractivePool __attribute__ ((unused)) &pool, unsigned int __attribute__ ((unused)) index)
 {
-	if (directionMoving == eFACING_LEFT)
-		m_xVelocity *= -1.0;
+    GLOBALS::player.AddAmmo(5); // 5 = number of shots awarded for each ammo collected
+    GLOBALS::sound.Post(eSOUND_AMMO_PICKUP);
+    return true;
+}
 
-    printf("\nDBUG: created bullet at (%d, %d) moving %d", x, y, directionMoving);
-};
 
-void TBullet::Tick(double delta_seconds)
+bool TPushable::PlayerTouched(TInteractivePool &pool, unsigned int index)
 {
-	m_xReal += (delta_seconds * m_xVelocity); // velocity in pixels per second
-	m_x = int(m_xReal);
+    const double oldX = pool.x[index];
+    const double oldY = pool.y[index];
+    const signed int width = pool.drawWidth[index];
+    double push = 0.0;
+
+    if ((GLOBALS::player.m_x < oldX) && (GLOBALS::player.Facing() == eFACING_RIGHT)) // player is on left, trying to push right
+        push = (GLOBALS::player.m_x + GLOBALS::player.DrawWidth()) - oldX;
+    else if ((GLOBALS::player.m_x > oldX) && (GLOBALS::player.Facing() == eFACING_LEFT)) // player is on right, trying to push left
+        push = (GLOBALS::player.m_x - width) - oldX;
+
+    // slides up against a wall rather than into it
+    if (push != 0.0)
+        pool.x[index] = oldX + SweepBox(oldX, oldY, width, TILE_HEIGHT_PIXELS_UNSCALED, push, 0.0).distance;
 
-	// if colliding with a map bounding border, need to delete myself
+    // always returns false because pushables are never removed, even when touched
+    return false;
 }
 
-bool TBullet::CollidedWith(TObject __attribute__ ((unused)) &obj)
+
+void TBullet::Spawn(TInteractives &interactives, signed int x, signed int y, TFacing directionMoving)
 {
-	// always return true because bullets are always removed when they collide with something,
-	// regardless of what it was.
-	return true;
+    const TInteractiveRef ref = interactives.Spawn(eINTERACTIVE_BULLET, TILE_ID, x, y, GLOBALS::sprites.Frame(TILE_ID).Right());
+    TInteractivePool &pool = interactives.Pool(eINTERACTIVE_BULLET);
+
+    pool.xVelocityPerSecond[IndexOfRef(ref)] = (directionMoving == eFACING_LEFT) ?
+                                                    -(TILE_WIDTH_PIXELS_UNSCALED * 3) :
+                                                     (TILE_WIDTH_PIXELS_UNSCALED * 3);
+
+    GLOBALS::sound.Post(eSOUND_FIRE);
+
+    TRACE_INFO("created bullet", "x", x, "y", y);
 }
 
-TBullet::~TBullet()
+void TBullet::Tick(TInteractivePool &pool, double delta_seconds, std::vector<TInteractiveRef> &stopped)
 {
-	GLOBALS::player.BulletDied();
+    const unsigned int count = pool.Count();
+    const TSpriteRegistry::TFrame &frame = GLOBALS::sprites.Frame(TILE_ID);
+
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        // velocity in pixels per second. Bullets only ever travel horizontally
+        const TSweepResult hit = SweepBox(pool.x[i] + frame.offsetX, pool.y[i] + frame.offsetY, frame.width, frame.height,
+                                          delta_seconds * pool.xVelocityPerSecond[i], 0.0);
+
+        pool.x[i] += hit.distance;
+
+        // ran into a wall, or off the edge of the level
+        if (hit.face)
+            stopped.push_back(MakeInteractiveRef(eINTERACTIVE_BULLET, i));
+    }
 }
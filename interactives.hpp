@@ -1,12 +1,20 @@
 #ifndef _INTERACTIVES_HPP_
 #define _INTERACTIVES_HPP_
 
+#include <vector>
+#include <unordered_map>
+
 #include "sam_shared.hpp"
+#include "spatial_grid.hpp"
 
 class TObject
 {
 public:
-    TObject(unsigned int tileID, signed int x, signed int y) : m_x(x), m_y(y), m_tileID(tileID) {};
+    TObject(unsigned int tileID, signed int x, signed int y) :
+                m_x(x), m_y(y),
+                m_previousX(x), m_previousY(y),
+                m_tileID(tileID)
+        {};
     virtual ~TObject() {}; // don't need to do anything for this class,
                            // but child classes may have more complex destruction needs
 
@@ -16,10 +24,19 @@ public:
     virtual signed int DrawWidth() const { return TILE_WIDTH_PIXELS_UNSCALED; };
     virtual bool CollidedWith(TObject __attribute__ ((unused)) &obj) { return false; };
 
+    // remember where the object was at the start of a simulation tick, so drawing can blend
+    // between that and where it ends up
+    void StorePreviousPosition() { m_previousX = m_x; m_previousY = m_y; };
+
+    // alpha: 0.0 is the previous position, 1.0 the current one
+    double InterpolatedX(double alpha) const { return m_previousX + ((m_x - m_previousX) * alpha); };
+    double InterpolatedY(double alpha) const { return m_previousY + ((m_y - m_previousY) * alpha); };
+
     // unscaled pixels
     double m_x, m_y;
 
 protected:
+    double m_previousX, m_previousY;
     unsigned int m_tileID;
 };
 
@@ -46,6 +63,9 @@ typedef void (TPlayer::*TStateRoutine)(void);
 
 class TPlayer : public TMobile
 {
+    // lets the micro-benchmarks time the movement routines on their own
+    friend class TPlayerBenchmark;
+
 public:
     typedef enum
     {
@@ -134,74 +154,173 @@ private:
 
 };
 
-class TGlasses : public TObject
+// Structure-of-arrays storage for every interactive of one kind. Index i of each array belongs to
+// the same interactive, so update and draw passes can stream straight through the arrays.
+// Arrays that a kind has no use for are simply left at their defaults.
+class TInteractivePool
 {
 public:
-    TGlasses(signed int x, signed int y) : TObject(52, x, y) {};
+    // unscaled pixels
+    std::vector<double> x, y;
+    std::vector<double> previousX, previousY; // as of the start of the current simulation tick
+    std::vector<double> xVelocityPerSecond;
+
+    std::vector<unsigned short> tileID;
+    std::vector<unsigned char> drawWidth;
+
+    // animation state
+    std::vector<unsigned char> frameIndex;
+    std::vector<double> secondsSinceFrameChange;
 
-    virtual bool CollidedWith(TObject &obj);
+    std::vector<unsigned short> timesShot;
+
+    unsigned int Count() const { return x.size(); };
+
+    // returns the index of the new interactive
+    unsigned int Append(unsigned int newTileID, double newX, double newY, signed int newDrawWidth);
+
+    // Removes by moving the last interactive into index. Returns the index the moved interactive
+    // used to have (which is index itself when the last one was removed).
+    unsigned int RemoveAt(unsigned int index);
+
+    // keeps the allocated storage for the next level
+    void Clear();
 };
 
-class TSatelliteDish : public TObject
+// Every interactive in the level, one pool per kind, plus the broadphase grid over all of them.
+//
+// Only the interactives within the active region around the player are awake; everything further
+// away sleeps and costs nothing per tick, so a bigger level doesn't make a tick any slower. Sleeping
+// only skips Tick() and StorePreviousPositions(): the player touching, or a bullet hitting, an
+// interactive still reaches it wherever it is. Bullets are always awake.
+class TInteractives
 {
 public:
-	TSatelliteDish(signed int x, signed int y) : TObject(357, x, y), m_frameIndex(0), m_seconds_since_last_frame_change(0.0), m_timesShot(0) {};
-    virtual void Tick(double delta_seconds);
+    void Reset(signed int levelWidthPixels, signed int levelHeightPixels);
 
-    virtual bool CollidedWith(TObject &obj);
+    // Wakes everything within the active region centered on x, y (unscaled pixels) and puts everything
+    // else to sleep. Call at the start of each simulation tick, before StorePreviousPositions().
+    void Activate(double x, double y);
 
-    virtual unsigned int TileID() const;
-    virtual signed int DrawWidth() const;
+    unsigned int AwakeCount() const { return m_awake.size(); };
 
-private:
-	enum /* class-static definitions */
-	{
-		eFRAMES_PER_ANIMATION = 4
-	};
+    TInteractiveRef Spawn(TInteractiveKind kind, unsigned int tileID, signed int x, signed int y,
+                          signed int drawWidth = TILE_WIDTH_PIXELS_UNSCALED);
 
-    unsigned int m_frameIndex;
-    double m_seconds_since_last_frame_change;
-    
-    unsigned int m_timesShot;
+    // Destroys everything in doomed, which may hold duplicates and is left sorted.
+    // Removal moves interactives around within their pool, so refs held elsewhere are no longer valid afterwards.
+    // Puts everything to sleep for the rest of the tick, for the same reason.
+    void Destroy(std::vector<TInteractiveRef> &doomed);
 
-    static const unsigned int frames[eFRAMES_PER_ANIMATION];
-    static const signed int widths[eFRAMES_PER_ANIMATION];
+    // call after changing the position of an interactive
+    void Moved(TInteractiveRef ref);
+
+    void Tick(double delta_seconds);
+
+    // call at the start of each simulation tick, before anything moves
+    void StorePreviousPositions();
+
+    // position for drawing, alpha of the way from the start of the tick to now
+    double InterpolatedX(TInteractiveRef ref, double alpha) const;
+    double InterpolatedY(TInteractiveRef ref, double alpha) const;
+
+    // broadphase candidates within a rectangle (unscaled pixels). See TSpatialGrid::Query.
+    void Query(signed int x, signed int y, signed int width, signed int height, std::vector<TInteractiveRef> &found) const
+        { m_grid.Query(x, y, width, height, found); };
+
+    // what happens when the player touches ref / when a bullet hits ref.
+    // returns true if ref needs to be removed from the level.
+    bool PlayerTouched(TInteractiveRef ref);
+    bool ShotHit(TInteractiveRef ref);
+
+    TInteractivePool &Pool(TInteractiveKind kind) { return m_pools[kind]; };
+    const TInteractivePool &Pool(TInteractiveKind kind) const { return m_pools[kind]; };
+
+    enum
+    {
+        // unscaled. Twice the viewport each way, so what's just off screen is already moving when it comes into view
+        ACTIVE_WIDTH_PIXELS = VIEWPORT_WIDTH_PIXELS_UNSCALED * 2,
+        ACTIVE_HEIGHT_PIXELS = VIEWPORT_HEIGHT_PIXELS_UNSCALED * 2
+    };
+
+    unsigned int TileID(TInteractiveRef ref) const { return m_pools[KindOfRef(ref)].tileID[IndexOfRef(ref)]; };
+    signed int DrawWidth(TInteractiveRef ref) const { return m_pools[KindOfRef(ref)].drawWidth[IndexOfRef(ref)]; };
+    double X(TInteractiveRef ref) const { return m_pools[KindOfRef(ref)].x[IndexOfRef(ref)]; };
+    double Y(TInteractiveRef ref) const { return m_pools[KindOfRef(ref)].y[IndexOfRef(ref)]; };
+
+private:
+    TInteractivePool m_pools[eINTERACTIVE_KIND_COUNT];
+    TSpatialGrid m_grid;
+
+    // everything but bullets in the active region as of the last Activate(), sorted
+    std::vector<TInteractiveRef> m_awake;
 };
 
+// Behaviour of each kind of interactive. None of these hold any state of their own,
+// everything about an individual interactive lives in its kind's TInteractivePool.
 
-class TAmmo : public TObject
+class TGlasses
 {
 public:
-    TAmmo(signed int x, signed int y) : TObject(354, x, y) {};
+    enum
+    {
+        TILE_ID = 52,
+        PLATFORM_TILE_ID = 53 // what the invisible platforms look like once revealed
+    };
 
-    virtual bool CollidedWith(TObject &obj) override;
+    static bool PlayerTouched(TInteractivePool &pool, unsigned int index);
 };
 
+class TSatelliteDish
+{
+public:
+    enum /* class-static definitions */
+    {
+        eFRAMES_PER_ANIMATION = 4
+    };
+
+    static void Tick(TInteractivePool &pool, unsigned int index, double delta_seconds);
+    static bool ShotHit(TInteractivePool &pool, unsigned int index);
+
+    static const unsigned int frames[eFRAMES_PER_ANIMATION];
 
-class TPushable : public TObject
+    // how far the art of frames[frameIndex] reaches across its tile
+    static signed int Width(unsigned int frameIndex);
+};
+
+
+class TAmmo
 {
 public:
-    TPushable(unsigned int tileID, signed int x, signed int y);
+    enum
+    {
+        TILE_ID = 354
+    };
 
-    virtual bool CollidedWith(TObject &obj) override;
+    static bool PlayerTouched(TInteractivePool &pool, unsigned int index);
 };
 
 
-class TBullet : public TObject
+class TPushable
 {
 public:
-    TBullet(signed int x, signed int y, TFacing directionMoving);
-    virtual ~TBullet();
+    static bool PlayerTouched(TInteractivePool &pool, unsigned int index);
+};
 
-    virtual void Tick(double delta_seconds) override;
-    virtual signed int DrawWidth() const override { return 7; };
-    virtual bool CollidedWith(TObject &obj) override;
 
-private:
-    double m_xReal, m_xVelocity;
+class TBullet
+{
+public:
+    enum
+    {
+        TILE_ID = 280
+    };
+
+    static void Spawn(TInteractives &interactives, signed int x, signed int y, TFacing directionMoving);
 
-    TBullet(const TBullet&) = delete; /* disable copy constructor [C++1] */
-    TBullet& operator=(const TBullet&) = delete; /* disable assignment operator [C++11] */
+    // Adds the bullets that hit something solid to stopped. Runs into walls with the
+    // trimmed extent of the bullet's sprite frame, rather than its whole tile.
+    static void Tick(TInteractivePool &pool, double delta_seconds, std::vector<TInteractiveRef> &stopped);
 };
 
 #endif
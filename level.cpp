@@ -0,0 +1,600 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cassert>
+#include <vector>
+#include <unordered_map>
+
+#include <physfs.h>
+
+#include "sam_shared.hpp"
+#include "level.hpp"
+#include "trace.hpp"
+
+// File layout. Every value is a little-endian 16 bit word, as that's all a TileStudio #binfile can hold:
+//   word 0-1  "SLVL"                    magic
+//   word 2    version                   LEVEL_FILE_VERSION
+//   word 3    header size, in words     the first layer starts straight after the header
+//   word 4    width, in tiles
+//   word 5    height, in tiles
+//   word 6    layer count               eLAYER_COUNT
+//   word 7    reserved, 0
+// then the layers, in TLevelLayer order, width * height words apiece and each one row by row.
+static const char LEVEL_MAGIC[4] = { 'S', 'L', 'V', 'L' };
+
+enum
+{
+    LEVEL_FILE_VERSION = 1,
+
+    HEADER_VERSION = 2,
+    HEADER_SIZE,
+    HEADER_WIDTH,
+    HEADER_HEIGHT,
+    HEADER_LAYERS,
+
+    MIN_HEADER_SIZE = 8 // words
+};
+
+namespace GLOBALS
+{
+    TLevel level;
+}
+
+static bool LittleEndianHost(void)
+{
+    const PHYSFS_uint16 one = 1;
+
+    return *(const unsigned char *)&one == 1;
+}
+
+TLevel::TLevel() :
+        m_file(NULL),
+        m_widthTiles(0),
+        m_heightTiles(0),
+        m_layersStart(0),
+        m_lastChunk(NULL),
+        m_useClock(0),
+        m_streamChunkX(-1),
+        m_streamChunkY(-1),
+        m_readFailed(false),
+        m_platformsRevealed(false),
+        m_platformTileID(-1)
+{
+}
+
+TLevel::~TLevel()
+{
+    Unload();
+}
+
+bool TLevel::Load(const char *filename)
+{
+    PHYSFS_File *file = PHYSFS_openRead(filename);
+    PHYSFS_uint16 header[MIN_HEADER_SIZE];
+
+    if (file == NULL)
+    {
+        fprintf(stderr, "\nERROR: unable to open level '%s'. Specifically:\n\t'%s'",
+                        filename, PHYSFS_getLastError());
+        return false;
+    }
+
+    if ((PHYSFS_read(file, header, sizeof(header), 1) != 1) ||
+        (memcmp(header, LEVEL_MAGIC, sizeof(LEVEL_MAGIC)) != 0))
+    {
+        fprintf(stderr, "\nERROR: '%s' is not a level", filename);
+        PHYSFS_close(file);
+        return false;
+    }
+
+    for (unsigned int i = HEADER_VERSION; i < MIN_HEADER_SIZE; ++i)
+        header[i] = PHYSFS_swapULE16(header[i]);
+
+    if ((header[HEADER_VERSION] != LEVEL_FILE_VERSION) || (header[HEADER_SIZE] < MIN_HEADER_SIZE) ||
+        (header[HEADER_LAYERS] != eLAYER_COUNT))
+    {
+        fprintf(stderr, "\nERROR: level '%s' is version %u with %u layers, expected version %u with %u",
+                        filename, header[HEADER_VERSION], header[HEADER_LAYERS], LEVEL_FILE_VERSION, eLAYER_COUNT);
+        PHYSFS_close(file);
+        return false;
+    }
+
+    // the camera can't show anything smaller than a screen
+    if ((header[HEADER_WIDTH] < VIEWPORT_WIDTH_TILES) || (header[HEADER_HEIGHT] < VIEWPORT_HEIGHT_TILES))
+    {
+        fprintf(stderr, "\nERROR: level '%s' is %ux%u tiles, it must be at least %dx%d",
+                        filename, header[HEADER_WIDTH], header[HEADER_HEIGHT], VIEWPORT_WIDTH_TILES, VIEWPORT_HEIGHT_TILES);
+        PHYSFS_close(file);
+        return false;
+    }
+
+    m_layersStart = header[HEADER_SIZE] * 2;
+    if (PHYSFS_fileLength(file) != (PHYSFS_sint64)(m_layersStart + (PHYSFS_uint64)eLAYER_COUNT * header[HEADER_WIDTH] * header[HEADER_HEIGHT] * 2))
+    {
+        fprintf(stderr, "\nERROR: level '%s' is truncated or corrupt", filename);
+        PHYSFS_close(file);
+        return false;
+    }
+
+    Unload();
+
+    m_file = file;
+    m_widthTiles = header[HEADER_WIDTH];
+    m_heightTiles = header[HEADER_HEIGHT];
+
+    m_chunks.resize(MAX_RESIDENT_CHUNKS);
+    for (unsigned int slot = MAX_RESIDENT_CHUNKS; slot > 0; --slot)
+        m_freeSlots.push_back(slot - 1);
+
+    if (!ReadSpawns())
+    {
+        fprintf(stderr, "\nERROR: unable to read the spawns of level '%s'. Specifically:\n\t'%s'",
+                        filename, PHYSFS_getLastError());
+        Unload();
+        return false;
+    }
+
+    TRACE_INFO("opened level", "width", m_widthTiles, "height", m_heightTiles);
+    TRACE_INFO("read level spawns", "count", m_spawns.size(), NULL, 0);
+
+    return true;
+}
+
+void TLevel::Unload()
+{
+    if (m_file)
+        PHYSFS_close(m_file);
+    m_file = NULL;
+
+    m_widthTiles = m_heightTiles = 0;
+    m_chunks.clear();
+    m_freeSlots.clear();
+    m_resident.clear();
+    m_lastChunk = NULL;
+    m_streamChunkX = m_streamChunkY = -1;
+    m_readFailed = false;
+    m_platformsRevealed = false;
+    m_changes.clear();
+    m_dirty.clear();
+    m_spawns.clear();
+}
+
+// the codes that put something into the level: the player, or an interactive
+static bool IsSpawnCode(signed short code)
+{
+    return (code == eCODE_PLAYER_SPAWN) || (code == eCODE_GLASSES) || (code == eCODE_TNT) ||
+           (code == eCODE_PUSHABLE) || (code == eCODE_AMMO) || (code == eCODE_SATELLITE_DISH);
+}
+
+bool TLevel::ReadSpawns()
+{
+    std::vector<signed short> codes(m_widthTiles), mids(m_widthTiles);
+    signed int midsRow = -1;
+
+    m_spawns.clear();
+
+    // straight from the file a row at a time, so as not to read in every chunk of the level just for these
+    for (signed int row = 0; row < m_heightTiles; ++row)
+    {
+        if (!PHYSFS_seek(m_file, m_layersStart + (((PHYSFS_uint64)eLAYER_CODES * m_heightTiles + row) * m_widthTiles * 2)) ||
+            (PHYSFS_read(m_file, &codes[0], m_widthTiles * 2, 1) != 1))
+        {
+            return false;
+        }
+
+        for (signed int column = 0; column < m_widthTiles; ++column)
+        {
+            const signed short code = LittleEndianHost() ? codes[column] : PHYSFS_swapSLE16(codes[column]);
+
+            if (!IsSpawnCode(code))
+                continue;
+
+            // only rows with something in them need their mid layer too
+            if (midsRow != row)
+            {
+                if (!PHYSFS_seek(m_file, m_layersStart + (((PHYSFS_uint64)eLAYER_MID_TILES * m_heightTiles + row) * m_widthTiles * 2)) ||
+                    (PHYSFS_read(m_file, &mids[0], m_widthTiles * 2, 1) != 1))
+                {
+                    return false;
+                }
+                midsRow = row;
+            }
+
+            TSpawn spawn;
+            spawn.tileX = column;
+            spawn.tileY = row;
+            spawn.code = code;
+            spawn.midTileID = LittleEndianHost() ? mids[column] : PHYSFS_swapSLE16(mids[column]);
+            m_spawns.push_back(spawn);
+        }
+    }
+
+    return true;
+}
+
+TLevel::TChunk *TLevel::Chunk(signed int chunkX, signed int chunkY)
+{
+    TChunk *chunk = m_lastChunk;
+
+    if ((chunk == NULL) || (chunk->chunkX != chunkX) || (chunk->chunkY != chunkY))
+    {
+        std::unordered_map<unsigned int, unsigned int>::const_iterator it = m_resident.find(ChunkKey(chunkX, chunkY));
+
+        chunk = (it != m_resident.end()) ? &m_chunks[it->second] : ReadChunk(chunkX, chunkY);
+        if (chunk == NULL)
+        {
+            m_readFailed = true;
+            return NULL;
+        }
+        m_lastChunk = chunk;
+    }
+
+    chunk->lastUsed = ++m_useClock;
+    return chunk;
+}
+
+TLevel::TChunk *TLevel::ReadChunk(signed int chunkX, signed int chunkY)
+{
+    const signed int left = chunkX << CHUNK_SHIFT;
+    const signed int top = chunkY << CHUNK_SHIFT;
+    const signed int columns = min(CHUNK_SIZE_TILES, m_widthTiles - left);
+    const signed int rows = min(CHUNK_SIZE_TILES, m_heightTiles - top);
+    unsigned int slot, oldest;
+
+    assert(m_file != NULL);
+
+    if (m_freeSlots.empty())
+    {
+        // full up, so make room by dropping whichever chunk has gone unused the longest
+        oldest = 0;
+        for (slot = 1; slot < MAX_RESIDENT_CHUNKS; ++slot)
+        {
+            if (m_chunks[slot].lastUsed < m_chunks[oldest].lastUsed)
+                oldest = slot;
+        }
+        EvictChunk(oldest);
+    }
+
+    slot = m_freeSlots.back();
+    m_freeSlots.pop_back();
+
+    TChunk &chunk = m_chunks[slot];
+    chunk.chunkX = chunkX;
+    chunk.chunkY = chunkY;
+    chunk.resident = true;
+
+    for (unsigned int layer = 0; layer < eLAYER_COUNT; ++layer)
+    {
+        // chunks hanging off the right or bottom of the level are padded with nothing
+        const signed short nothing = (layer < eLAYER_BOUNDS) ? -1 : 0;
+        for (unsigned int i = 0; i < CHUNK_TILES; ++i)
+            chunk.layers[layer][i] = nothing;
+
+        for (signed int row = 0; row < rows; ++row)
+        {
+            signed short *tiles = &chunk.layers[layer][row << CHUNK_SHIFT];
+            const PHYSFS_uint64 offset = m_layersStart +
+                                         ((((PHYSFS_uint64)layer * m_heightTiles + top + row) * m_widthTiles) + left) * 2;
+
+            if (!PHYSFS_seek(m_file, offset) || (PHYSFS_read(m_file, tiles, columns * 2, 1) != 1))
+            {
+                fprintf(stderr, "\nERROR: unable to read level chunk %d,%d. Specifically:\n\t'%s'",
+                                chunkX, chunkY, PHYSFS_getLastError());
+
+                // never left half read, the slot goes straight back
+                chunk.resident = false;
+                m_freeSlots.push_back(slot);
+                return NULL;
+            }
+
+            // files are little-endian, which is nearly everything the game runs on, so this is almost never needed
+            if (!LittleEndianHost())
+            {
+                for (signed int column = 0; column < columns; ++column)
+                    tiles[column] = PHYSFS_swapSLE16(tiles[column]);
+            }
+        }
+    }
+
+    if (m_platformsRevealed)
+        RevealPlatforms(chunk, true);
+
+    // and anything changed since the level was loaded, which may be on top of a revealed platform
+    std::unordered_map<unsigned int, TChunkChanges>::const_iterator changes = m_changes.find(ChunkKey(chunkX, chunkY));
+    if (changes != m_changes.end())
+    {
+        for (std::vector<TTileChange>::const_iterator it = changes->second.list.begin(); it != changes->second.list.end(); ++it)
+            chunk.layers[it->layer][it->tile] = it->value;
+    }
+
+    for (signed int column = 0; column < CHUNK_SIZE_TILES; ++column)
+        UpdateDistanceFields(chunk, column);
+
+    m_resident[ChunkKey(chunkX, chunkY)] = slot;
+
+    TRACE_DEBUG("read level chunk", "x", chunkX, "y", chunkY);
+
+    return &chunk;
+}
+
+void TLevel::EvictChunk(unsigned int slot)
+{
+    TChunk &chunk = m_chunks[slot];
+
+    TRACE_DEBUG("evicted level chunk", "x", chunk.chunkX, "y", chunk.chunkY);
+
+    chunk.resident = false;
+    m_resident.erase(ChunkKey(chunk.chunkX, chunk.chunkY));
+    m_freeSlots.push_back(slot);
+
+    if (m_lastChunk == &chunk)
+        m_lastChunk = NULL;
+}
+
+void TLevel::UpdateDistanceFields(TChunk &chunk, signed int column)
+{
+    unsigned char ground = NO_ROW, ceiling = NO_ROW;
+    signed int row;
+
+    for (row = CHUNK_SIZE_TILES - 1; row >= 0; --row)
+    {
+        if (chunk.layers[eLAYER_BOUNDS][(row << CHUNK_SHIFT) | column] & SOLID_TOP)
+            ground = row;
+        chunk.groundRow[(row << CHUNK_SHIFT) | column] = ground;
+    }
+
+    for (row = 0; row < CHUNK_SIZE_TILES; ++row)
+    {
+        if (chunk.layers[eLAYER_BOUNDS][(row << CHUNK_SHIFT) | column] & SOLID_BOTTOM)
+            ceiling = row;
+        chunk.ceilingRow[(row << CHUNK_SHIFT) | column] = ceiling;
+    }
+}
+
+signed int TLevel::FirstGroundRow(signed int tileX, signed int fromRow, signed int toRow)
+{
+    signed int row = max(0, fromRow);
+
+    toRow = min(toRow, m_heightTiles - 1);
+    if ((tileX < 0) || (tileX >= m_widthTiles))
+        return toRow + 1;
+
+    while (row <= toRow)
+    {
+        const TChunk *chunk = Chunk(tileX >> CHUNK_SHIFT, row >> CHUNK_SHIFT);
+        if (chunk == NULL)
+            return toRow + 1;
+
+        const unsigned char found = chunk->groundRow[((row & CHUNK_MASK) << CHUNK_SHIFT) | (tileX & CHUNK_MASK)];
+
+        if (found != NO_ROW)
+            return min(toRow + 1, (row & ~CHUNK_MASK) + found);
+
+        // nothing more in this chunk, on to the top of the next one down
+        row = (row | CHUNK_MASK) + 1;
+    }
+
+    return toRow + 1;
+}
+
+signed int TLevel::FirstCeilingRow(signed int tileX, signed int fromRow, signed int toRow)
+{
+    signed int row = min(fromRow, m_heightTiles - 1);
+
+    toRow = max(toRow, 0);
+    if ((tileX < 0) || (tileX >= m_widthTiles))
+        return toRow - 1;
+
+    while (row >= toRow)
+    {
+        const TChunk *chunk = Chunk(tileX >> CHUNK_SHIFT, row >> CHUNK_SHIFT);
+        if (chunk == NULL)
+            return toRow - 1;
+
+        const unsigned char found = chunk->ceilingRow[((row & CHUNK_MASK) << CHUNK_SHIFT) | (tileX & CHUNK_MASK)];
+
+        if (found != NO_ROW)
+            return max(toRow - 1, (row & ~CHUNK_MASK) + found);
+
+        // nothing more in this chunk, on to the bottom of the next one up
+        row = (row & ~CHUNK_MASK) - 1;
+    }
+
+    return toRow - 1;
+}
+
+void TLevel::SetTile(TLevelLayer layer, signed int tileX, signed int tileY, signed short value)
+{
+    if ((tileX < 0) || (tileY < 0) || (tileX >= m_widthTiles) || (tileY >= m_heightTiles))
+        return;
+
+    TChunk *chunk = Chunk(tileX >> CHUNK_SHIFT, tileY >> CHUNK_SHIFT);
+    const unsigned int tile = ((tileY & CHUNK_MASK) << CHUNK_SHIFT) | (tileX & CHUNK_MASK);
+
+    if ((chunk == NULL) || (chunk->layers[layer][tile] == value))
+        return;
+
+    RecordChange(*chunk, layer, tile, chunk->layers[layer][tile], value, true);
+
+    chunk->layers[layer][tile] = value;
+    if (layer == eLAYER_BOUNDS)
+        UpdateDistanceFields(*chunk, tileX & CHUNK_MASK);
+
+    MarkDirty(ChunkKey(chunk->chunkX, chunk->chunkY), tile);
+}
+
+void TLevel::RecordChange(const TChunk &chunk, unsigned int layer, unsigned int tile, signed short original, signed short value, bool replace)
+{
+    // a chunk's first change adds it with no tiles yet indexed
+    TChunkChanges &changes = m_changes[ChunkKey(chunk.chunkX, chunk.chunkY)];
+    unsigned short &index = changes.index[layer][tile];
+
+    // a tile changed before keeps what it was to start with
+    if (index != 0)
+    {
+        if (replace)
+            changes.list[index - 1].value = value;
+        return;
+    }
+
+    const TTileChange change = { (unsigned char)layer, (unsigned char)tile, value, original };
+    changes.list.push_back(change);
+    index = changes.list.size();
+}
+
+void TLevel::RevealPlatforms(TChunk &chunk, bool justRead)
+{
+    const unsigned int key = ChunkKey(chunk.chunkX, chunk.chunkY);
+
+    for (unsigned int i = 0; i < CHUNK_TILES; ++i)
+    {
+        if (chunk.layers[eLAYER_CODES][i] == eCODE_INVISIBLE_PLATFORM)
+        {
+            // Recorded like any other change, so that Revert() can hide them again. A chunk that's just been read
+            // in was revealed before, and anything already recorded for it happened after that.
+            RecordChange(chunk, eLAYER_CODES, i, eCODE_INVISIBLE_PLATFORM, 0, !justRead);
+            RecordChange(chunk, eLAYER_BOUNDS, i, chunk.layers[eLAYER_BOUNDS][i], SOLID_TOP, !justRead);
+            RecordChange(chunk, eLAYER_MID_TILES, i, chunk.layers[eLAYER_MID_TILES][i], m_platformTileID, !justRead);
+
+            chunk.layers[eLAYER_CODES][i] = 0;
+            chunk.layers[eLAYER_BOUNDS][i] = SOLID_TOP;
+            chunk.layers[eLAYER_MID_TILES][i] = m_platformTileID;
+
+            // Even when just read in: whatever was drawn from this chunk while it was last in memory may
+            // predate the reveal. Just the platforms, not the whole chunk.
+            MarkDirty(key, i);
+        }
+    }
+}
+
+void TLevel::RevealInvisiblePlatforms(signed short tileID)
+{
+    // already done
+    if (m_platformsRevealed && (m_platformTileID == tileID))
+        return;
+
+    m_platformsRevealed = true;
+    m_platformTileID = tileID;
+
+    // only what's in memory now, everything else is revealed (and marked dirty) as it's read in
+    for (std::unordered_map<unsigned int, unsigned int>::const_iterator it = m_resident.begin(); it != m_resident.end(); ++it)
+    {
+        TChunk &chunk = m_chunks[it->second];
+
+        RevealPlatforms(chunk, false);
+        for (signed int column = 0; column < CHUNK_SIZE_TILES; ++column)
+            UpdateDistanceFields(chunk, column);
+    }
+}
+
+void TLevel::MarkDirty(unsigned int chunkKey, unsigned int tile)
+{
+    // a chunk's first change adds it with nothing yet marked
+    TDirtyTiles &dirty = m_dirty[chunkKey];
+
+    dirty.rows[tile >> CHUNK_SHIFT] |= 1 << (tile & CHUNK_MASK);
+}
+
+void TLevel::Revert()
+{
+    for (std::unordered_map<unsigned int, TChunkChanges>::const_iterator changes = m_changes.begin(); changes != m_changes.end(); ++changes)
+    {
+        std::unordered_map<unsigned int, unsigned int>::const_iterator resident = m_resident.find(changes->first);
+
+        // chunks that aren't loaded are simply read in from the file again when next needed
+        TChunk *chunk = (resident != m_resident.end()) ? &m_chunks[resident->second] : NULL;
+
+        for (std::vector<TTileChange>::const_iterator it = changes->second.list.begin(); it != changes->second.list.end(); ++it)
+        {
+            if (chunk)
+                chunk->layers[it->layer][it->tile] = it->original;
+
+            MarkDirty(changes->first, it->tile);
+        }
+
+        if (chunk)
+        {
+            for (signed int column = 0; column < CHUNK_SIZE_TILES; ++column)
+                UpdateDistanceFields(*chunk, column);
+        }
+    }
+
+    m_changes.clear();
+    m_platformsRevealed = false;
+}
+
+void TLevel::TakeDirtyRects(std::vector<TTileRect> &rects)
+{
+    unsigned int first, last, run;
+
+    rects.clear();
+
+    for (std::unordered_map<unsigned int, TDirtyTiles>::iterator it = m_dirty.begin(); it != m_dirty.end(); ++it)
+    {
+        const signed int left = ChunkXOfKey(it->first) << CHUNK_SHIFT;
+        const signed int top = ChunkYOfKey(it->first) << CHUNK_SHIFT;
+        unsigned short *rows = it->second.rows;
+
+        for (signed int row = 0; row < CHUNK_SIZE_TILES; ++row)
+        {
+            while (rows[row] != 0)
+            {
+                // the leftmost run of changed tiles along the row...
+                for (first = 0; (rows[row] & (1 << first)) == 0; ++first)
+                    ;
+                for (last = first; (last + 1 < CHUNK_SIZE_TILES) && (rows[row] & (1 << (last + 1))); ++last)
+                    ;
+                run = (2 << last) - (1 << first);
+
+                // ...and the rows under it for as long as they changed in every one of the same columns
+                signed int bottom = row;
+                rows[row] &= ~run;
+                while ((bottom + 1 < CHUNK_SIZE_TILES) && ((rows[bottom + 1] & run) == run))
+                    rows[++bottom] &= ~run;
+
+                const TTileRect rect = { left + (signed int)first, top + row, left + (signed int)last, top + bottom };
+                rects.push_back(rect);
+            }
+        }
+    }
+
+    m_dirty.clear();
+}
+
+bool TLevel::Stream(double x, double y)
+{
+    const signed int centreX = min((signed int)x / TILE_WIDTH_PIXELS_UNSCALED,  m_widthTiles - 1)  >> CHUNK_SHIFT;
+    const signed int centreY = min((signed int)y / TILE_HEIGHT_PIXELS_UNSCALED, m_heightTiles - 1) >> CHUNK_SHIFT;
+    signed int chunkX, chunkY;
+
+    if (m_readFailed)
+        return false;
+
+    if ((centreX == m_streamChunkX) && (centreY == m_streamChunkY))
+        return true;
+
+    m_streamChunkX = centreX;
+    m_streamChunkY = centreY;
+
+    for (unsigned int slot = 0; slot < MAX_RESIDENT_CHUNKS; ++slot)
+    {
+        const TChunk &chunk = m_chunks[slot];
+
+        if (chunk.resident &&
+            ((abs(chunk.chunkX - centreX) > KEEP_RADIUS_CHUNKS) || (abs(chunk.chunkY - centreY) > KEEP_RADIUS_CHUNKS)))
+        {
+            EvictChunk(slot);
+        }
+    }
+
+    for (chunkY = max(0, centreY - STREAM_RADIUS_CHUNKS); chunkY <= min(ChunksHigh() - 1, centreY + STREAM_RADIUS_CHUNKS); ++chunkY)
+    {
+        for (chunkX = max(0, centreX - STREAM_RADIUS_CHUNKS); chunkX <= min(ChunksWide() - 1, centreX + STREAM_RADIUS_CHUNKS); ++chunkX)
+        {
+            if (Chunk(chunkX, chunkY) == NULL)
+                return false;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,210 @@
+#ifndef _LEVEL_HPP_
+#define _LEVEL_HPP_
+
+#include <vector>
+#include <unordered_map>
+
+#include <physfs.h>
+
+#include "sam_shared.hpp"
+
+// the layers of a level, in the order they are stored in a level file
+typedef enum
+{
+    eLAYER_BACK_TILES,
+    eLAYER_MID_TILES,
+    eLAYER_FRONT_TILES,
+    eLAYER_BOUNDS,
+    eLAYER_CODES,
+
+    eLAYER_COUNT // ALWAYS LAST - is the number of layers in a level
+} TLevelLayer;
+
+// something the codes layer puts into the level when it starts, and again every time it's reset
+typedef struct
+{
+    signed int tileX, tileY;
+    signed short code;
+    signed short midTileID; // what's in the mid layer of the same square
+} TSpawn;
+
+// a rectangle of tiles, inclusive on all sides
+typedef struct
+{
+    signed int left, top, right, bottom;
+} TTileRect;
+
+// A level of any size, kept in memory as square chunks of tiles. Only the chunks around the player,
+// plus the ones most recently looked at, are held at any one time; the rest are read back from the
+// level file when they're next needed. So memory use is the same however big the level is.
+//
+// The level file is never written to, it's the level as it was at the start. Tiles are only ever changed
+// through SetTile() and RevealInvisiblePlatforms(), and every change is remembered, along with what the
+// tile was to start with, to be applied again to chunks read in afterwards. So Revert() only has to undo
+// what changed. Every change, either way, is marked dirty, for anything drawn or worked out from the
+// tiles to bring itself up to date from.
+class TLevel
+{
+public:
+    TLevel();
+    ~TLevel();
+
+    // Opens a level file (layout in level.cpp, written by sam.tsd) through PhysFS, so it may be inside
+    // a .zip. Only the header and spawns are read here, chunks are read as they are needed. Keep level files
+    // stored (uncompressed) in a .zip, as reading a chunk seeks about the file.
+    bool Load(const char *filename);
+    void Unload();
+
+    signed int WidthTiles() const { return m_widthTiles; };
+    signed int HeightTiles() const { return m_heightTiles; };
+    signed int WidthPixels() const { return m_widthTiles * TILE_WIDTH_PIXELS_UNSCALED; };
+    signed int HeightPixels() const { return m_heightTiles * TILE_HEIGHT_PIXELS_UNSCALED; };
+
+    signed int ChunksWide() const { return (m_widthTiles + CHUNK_SIZE_TILES - 1) >> CHUNK_SHIFT; };
+    signed int ChunksHigh() const { return (m_heightTiles + CHUNK_SIZE_TILES - 1) >> CHUNK_SHIFT; };
+
+    // One tile of one layer. Off the edge of the level tile layers are -1, bounds and codes 0.
+    // Reads the tile's chunk in if it isn't already; if that fails, it's as if off the edge (see Stream()).
+    signed short Tile(TLevelLayer layer, signed int tileX, signed int tileY);
+
+    // The first row, from fromRow down to toRow, whose tile in column tileX has a solid top; toRow + 1 if none do.
+    // Whole chunks with no ground in that column are skipped in one step.
+    signed int FirstGroundRow(signed int tileX, signed int fromRow, signed int toRow);
+
+    // The first row, from fromRow up to toRow, whose tile in column tileX has a solid bottom; toRow - 1 if none do.
+    signed int FirstCeilingRow(signed int tileX, signed int fromRow, signed int toRow);
+
+    // Changes one tile of one layer, for as long as the level stays loaded. Off the edge of the level does nothing.
+    void SetTile(TLevelLayer layer, signed int tileX, signed int tileY, signed short value);
+
+    // Turns every invisible platform in the level, loaded or not, into a solid platform of tileID.
+    // Chunks that aren't loaded are brought up to date (and their platforms marked dirty) when read in.
+    void RevealInvisiblePlatforms(signed short tileID);
+
+    // Puts the rectangles changed since the last call into rects, replacing whatever was in it.
+    // Neighbouring changes within a chunk are merged, never taking in any tiles that didn't change.
+    void TakeDirtyRects(std::vector<TTileRect> &rects);
+
+    // back to the level as it was loaded, undoing every SetTile() and RevealInvisiblePlatforms()
+    void Revert();
+
+    // everything the level starts with, in row by row order. Worked out once, when the level is loaded.
+    const std::vector<TSpawn> &Spawns() const { return m_spawns; };
+
+    // Reads in the chunks around x, y (unscaled pixels) and drops the ones far away from it. Cheap to call
+    // every tick, it does nothing until x, y moves into a different chunk. False once any chunk, here or
+    // anywhere else, has failed to read, after which the level can't be played on.
+    bool Stream(double x, double y);
+
+    bool ReadFailed() const { return m_readFailed; };
+
+    unsigned int ResidentChunks() const { return m_resident.size(); };
+
+    enum
+    {
+        CHUNK_SHIFT = 4,
+        CHUNK_SIZE_TILES = 1 << CHUNK_SHIFT, // along each side
+        CHUNK_MASK = CHUNK_SIZE_TILES - 1,
+        CHUNK_TILES = CHUNK_SIZE_TILES * CHUNK_SIZE_TILES,
+
+        STREAM_RADIUS_CHUNKS = 2, // read in ahead of the player; covers the viewport wherever the player is in it
+        KEEP_RADIUS_CHUNKS = 3,   // dropped once further away than this, so walking back and forth doesn't thrash
+        MAX_RESIDENT_CHUNKS = 64, // if more than this are needed, the least recently used goes
+
+        NO_ROW = 0xFF
+    };
+
+private:
+    // a change to be applied to its chunk if it's read in again, or undone by Revert()
+    typedef struct
+    {
+        unsigned char layer;
+        unsigned char tile; // within the chunk
+        signed short value;
+        signed short original; // as in the level file
+    } TTileChange;
+
+    typedef struct
+    {
+        signed short layers[eLAYER_COUNT][CHUNK_TILES]; // row by row
+
+        // For each tile, the row within this chunk of the nearest tile at or below it (or at or above it)
+        // in the same column with a solid top (or bottom). NO_ROW if there isn't one.
+        unsigned char groundRow[CHUNK_TILES];
+        unsigned char ceilingRow[CHUNK_TILES];
+
+        signed int chunkX, chunkY;
+        unsigned int lastUsed;
+        bool resident; // false if the slot is free
+    } TChunk;
+
+    // every change to one chunk, in the order they were first made
+    typedef struct
+    {
+        std::vector<TTileChange> list;
+        unsigned short index[eLAYER_COUNT][CHUNK_TILES]; // 1 + where in list each tile's change is, 0 if it hasn't changed
+    } TChunkChanges;
+
+    // which tiles of a chunk have changed, a bit per column (so CHUNK_SIZE_TILES can't be more than 16) for each row
+    typedef struct
+    {
+        unsigned short rows[CHUNK_SIZE_TILES];
+    } TDirtyTiles;
+
+    static unsigned int ChunkKey(signed int chunkX, signed int chunkY) { return (chunkY << 16) | chunkX; };
+    static signed int ChunkXOfKey(unsigned int key) { return key & 0xFFFF; };
+    static signed int ChunkYOfKey(unsigned int key) { return key >> 16; };
+
+    // NULL if the chunk isn't resident and can't be read in
+    TChunk *Chunk(signed int chunkX, signed int chunkY);
+    TChunk *ReadChunk(signed int chunkX, signed int chunkY);
+    void EvictChunk(unsigned int slot);
+    bool ReadSpawns();
+    void RevealPlatforms(TChunk &chunk, bool justRead);
+    void RecordChange(const TChunk &chunk, unsigned int layer, unsigned int tile, signed short original, signed short value, bool replace);
+    void MarkDirty(unsigned int chunkKey, unsigned int tile);
+    void UpdateDistanceFields(TChunk &chunk, signed int column);
+
+    PHYSFS_File *m_file;
+    signed int m_widthTiles;
+    signed int m_heightTiles;
+    PHYSFS_uint64 m_layersStart; // bytes into the file
+
+    // MAX_RESIDENT_CHUNKS slots, allocated once so that chunks never move
+    std::vector<TChunk> m_chunks;
+    std::vector<unsigned int> m_freeSlots;
+    std::unordered_map<unsigned int, unsigned int> m_resident; // ChunkKey() -> slot
+
+    TChunk *m_lastChunk; // nearly every lookup is in the same chunk as the one before
+    unsigned int m_useClock;
+    signed int m_streamChunkX, m_streamChunkY;
+    bool m_readFailed;
+
+    bool m_platformsRevealed;
+    signed short m_platformTileID;
+
+    std::unordered_map<unsigned int, TChunkChanges> m_changes; // ChunkKey() -> changes
+    std::unordered_map<unsigned int, TDirtyTiles> m_dirty; // ChunkKey() -> tiles, for chunks with any
+
+    std::vector<TSpawn> m_spawns;
+};
+
+namespace GLOBALS
+{
+    // the level being played
+    extern TLevel level;
+}
+
+inline signed short TLevel::Tile(TLevelLayer layer, signed int tileX, signed int tileY)
+{
+    if ((tileX < 0) || (tileY < 0) || (tileX >= m_widthTiles) || (tileY >= m_heightTiles))
+        return (layer < eLAYER_BOUNDS) ? -1 : 0;
+
+    const TChunk *chunk = Chunk(tileX >> CHUNK_SHIFT, tileY >> CHUNK_SHIFT);
+    if (chunk == NULL)
+        return (layer < eLAYER_BOUNDS) ? -1 : 0;
+
+    return chunk->layers[layer][((tileY & CHUNK_MASK) << CHUNK_SHIFT) | (tileX & CHUNK_MASK)];
+}
+
+#endif
@@ -1,8 +1,14 @@
 #include <cstdio>
 #include <cstdlib>     /* srand, rand */
+#include <cstring>
 #include <ctime>
 #include <cassert>
-#include <list>
+#include <cmath>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <atomic>
+#include <deque>
 
 #include <allegro5/allegro.h>
 #include <allegro5/allegro_image.h>
@@ -18,39 +24,44 @@
 #include "sam_shared.hpp"
 
 #include "interactives.hpp"
-
-#include "level1.h"
+#include "collision.hpp"
+#include "action_log.hpp"
+#include "frame_timing.hpp"
+#include "trace.hpp"
+
+#include "level.hpp"
+#include "background.hpp"
+#include "sprites.hpp"
+#include "present.hpp"
+#include "atlas_cache.hpp"
+#include "asset_loader.hpp"
+#include "sound.hpp"
+#include "snapshot.hpp"
+#include "input_queue.hpp"
 
 const char *ORGANIZATION_NAME = "jdooley.org";
 const char *APPLICATION_NAME = "SAM4";
 
-const signed int TILE_WIDTH_PIXELS_UNSCALED  = 32;
-const signed int TILE_HEIGHT_PIXELS_UNSCALED = 32;
-
-const signed int VIEWPORT_WIDTH_TILES  = 20;
-const signed int VIEWPORT_HEIGHT_TILES = 15;
-
-const signed int VIEWPORT_WIDTH_PIXELS_UNSCALED  = VIEWPORT_WIDTH_TILES  * TILE_WIDTH_PIXELS_UNSCALED;
-const signed int VIEWPORT_HEIGHT_PIXELS_UNSCALED = VIEWPORT_HEIGHT_TILES * TILE_HEIGHT_PIXELS_UNSCALED;
-
-const signed int LEVEL_WIDTH_VIEWPORTS  = 2; // two screens wide
-const signed int LEVEL_HEIGHT_VIEWPORTS = 2; // two screens high
-
-const signed int LEVEL_WIDTH_TILES  = LEVEL_WIDTH_VIEWPORTS  * VIEWPORT_WIDTH_TILES;
-const signed int LEVEL_HEIGHT_TILES = LEVEL_HEIGHT_VIEWPORTS * VIEWPORT_HEIGHT_TILES;
-
 const signed int PLAYER_MAX_JUMP_HEIGHT_UNSCALED = (TILE_HEIGHT_PIXELS_UNSCALED * 2) + (TILE_HEIGHT_PIXELS_UNSCALED / 2);
 
-const signed int LEVEL_WIDTH_PIXELS_UNSCALED  = LEVEL_WIDTH_TILES  * TILE_WIDTH_PIXELS_UNSCALED;
-const signed int LEVEL_HEIGHT_PIXELS_UNSCALED = LEVEL_HEIGHT_TILES * TILE_HEIGHT_PIXELS_UNSCALED;
+const signed int STATUS_BAR_WIDTH_PIXELS_UNSCALED = TILE_WIDTH_PIXELS_UNSCALED * 4;
 
-const signed int SCALE_FACTOR = 2;
-const signed int SCREEN_WIDTH_PIXELS_SCALED  = VIEWPORT_WIDTH_PIXELS_UNSCALED  * SCALE_FACTOR;
-const signed int SCREEN_HEIGHT_PIXELS_SCALED = VIEWPORT_HEIGHT_PIXELS_UNSCALED * SCALE_FACTOR;
+const signed int FRAME_WIDTH_PIXELS_UNSCALED  = VIEWPORT_WIDTH_PIXELS_UNSCALED + STATUS_BAR_WIDTH_PIXELS_UNSCALED;
+const signed int FRAME_HEIGHT_PIXELS_UNSCALED = VIEWPORT_HEIGHT_PIXELS_UNSCALED;
 
 // how many seconds is each frame of the player's animation displayed for
 const double ANIMATION_RATE = 0.125;
 
+// the game world always advances in steps of exactly this length, however fast the display is
+const signed int SIMULATION_TICKS_PER_SECOND = 120;
+const double SIMULATION_TICK_SECONDS = 1.0 / SIMULATION_TICKS_PER_SECOND;
+
+// the most real time a single frame is allowed to account for
+const double MAX_FRAME_SECONDS = 0.25;
+
+// how much game time a headless run simulates when not told otherwise
+const double DEFAULT_HEADLESS_SECONDS = 600.0;
+
 
 namespace GLOBALS
 {
@@ -59,28 +70,117 @@ namespace GLOBALS
     ALLEGRO_BITMAP *tileAtlas_unscaled;
     ALLEGRO_FONT *defaultFont;
 
-    ALLEGRO_BITMAP *background_scaled;
+    bool headless = false;
 
     TPlayer player;
-    std::list<TObject *> interactives;
+    TInteractives interactives;
 }
 
+// --record writes every tick's actions to recordFilename when the game ends,
+// --replay feeds the ticks of a previously recorded game back in instead of the keyboard
+static TActionLog recording, replay;
+static const char *recordFilename = NULL;
+static bool replaying = false;
+
+// --scale picks how many display pixels each frame pixel becomes, rather than the largest that fits
+static signed int requestedScale = 0;
+
+// the F3 overlay
+static TFrameTimings frameTimings;
+
+// passes the world from the simulation's thread to the display's
+static TSnapshotBuffers snapshots;
+
+// what the keyboard is asking for, from the display's thread to the simulation's
+static TInputQueue inputQueue;
+
+// set by the simulation's thread once a replay runs out
+static std::atomic<bool> simulationOver(false);
+
+// Only touched by the simulation's thread (or before it starts): the tile changes the display may not
+// have seen yet, how many times tiles have changed at all, and the simulation's phases in the latest tick.
+static std::vector<TTileRect> unseenTileChanges;
+static unsigned int tilesVersion = 0;
+static double tickPhaseStart = 0.0;
+static double tickPhaseSeconds[ePHASE_COUNT];
+
+// everything read from disk before the game can start, loaded while the title screen shows
+static TAssetLoader assetLoader;
+
+// how many loaded bitmaps go into video memory between two title screen frames
+static const unsigned int UPLOADS_PER_FRAME = 1;
+
 /* create a wrapper to throw away the int return value of PHYSFS_deinit() */
 static void atexitwrapper_PhysFS_deinit(void) { PHYSFS_deinit(); }
 
-static bool InitGame(int argc, char **argv);
-static void DoTitleScreen(void);
+static bool InitDisplay(void);
+static void InitAudio(void);
+static bool LoadLevel(TAssetLoader &loader);
+static bool LoadTileAtlas(TAssetLoader &loader);
+static void TileAtlasUploaded(ALLEGRO_BITMAP *atlas);
+static bool DoTitleScreen(void);
+static void DrawTitleScreen(float progress);
 static void DoMainMenu(void);
-static void PlayGame(void);
-static void ShutdownGame(void);
-static void ResetLevel(void);
-static void ProcessAction(action_t action);
-static void DrawStatusBar(void);
-
-
+static bool PlayGame(void);
+static void *SimulationThread(ALLEGRO_THREAD *thread, void *arg);
+static bool ActionsForTick(TActionSet &actions);
+static bool SimulateTick(TActionSet actions);
+static void StartTickPhase(void);
+static void StopTickPhase(TFramePhase phase);
+static void PublishSnapshot(double time);
+static void ApplyTileChanges(const TWorldSnapshot &snapshot);
+static bool RunHeadless(double seconds, unsigned int seed);
+static TTileRect TileWindow(void);
+static void CameraPosition(double playerX, double playerY, signed int levelWidthPixels, signed int levelHeightPixels,
+                           signed int &worldX, signed int &worldY);
+static void DrawStatusBar(const TWorldSnapshot &snapshot);
+static void DrawDebugOverlay(const TWorldSnapshot &snapshot);
+
+
+// the micro-benchmarks (benchmark.cpp) link against everything in here except main() itself
+#ifndef SAM_BENCHMARK
 int main(int argc, char **argv)
 {
-    srand(time(NULL));
+    double headlessSeconds = DEFAULT_HEADLESS_SECONDS;
+    unsigned int seed = time(NULL);
+    const char *replayFilename = NULL;
+    const char *traceFilename = NULL;
+    int exitCode = 0;
+
+    for (int arg = 1; arg < argc; ++arg)
+    {
+        if (strcmp(argv[arg], "--headless") == 0)
+        {
+            GLOBALS::headless = true;
+
+            // optionally followed by how many seconds of game time to simulate
+            if ((arg + 1 < argc) && (argv[arg + 1][0] != '-'))
+                headlessSeconds = atof(argv[++arg]);
+        }
+        else if ((strcmp(argv[arg], "--seed") == 0) && (arg + 1 < argc))
+            seed = strtoul(argv[++arg], NULL, 0);
+        else if ((strcmp(argv[arg], "--record") == 0) && (arg + 1 < argc))
+            recordFilename = argv[++arg];
+        else if ((strcmp(argv[arg], "--replay") == 0) && (arg + 1 < argc))
+            replayFilename = argv[++arg];
+        else if ((strcmp(argv[arg], "--trace") == 0) && (arg + 1 < argc))
+            traceFilename = argv[++arg];
+        else if ((strcmp(argv[arg], "--scale") == 0) && (arg + 1 < argc))
+            requestedScale = atoi(argv[++arg]);
+        else
+        {
+            fprintf(stderr, "\nERROR: unknown option '%s'\n\n"
+                            "usage: %s [--headless [seconds]] [--seed number] [--record file | --replay file] [--trace file] [--scale number]\n",
+                            argv[arg], argv[0]);
+            return -1;
+        }
+    }
+
+    if (recordFilename && replayFilename)
+    {
+        fprintf(stderr, "\nERROR: can't record and replay at the same time\n");
+        return -1;
+    }
     
     if (!InitGame(argc, argv))
     {
@@ -88,15 +188,58 @@ int main(int argc, char **argv)
         return -1;        
     }
 
-    DoTitleScreen();
-    DoMainMenu();
+    // trace files and action logs live in the PhysFS write directory, so have to wait for that to be set up
+    if (traceFilename && !StartTracing(traceFilename))
+    {
+        ShutdownGame();
+        return -1;
+    }
+
+    if (replayFilename)
+    {
+        if (!replay.Load(replayFilename))
+        {
+            StopTracing();
+            ShutdownGame();
+            return -1;
+        }
+
+        // a replay is only the same game if it starts from the same seed
+        seed = replay.Seed();
+        replaying = true;
+    }
+
+    if (recordFilename)
+        recording.Clear(seed);
+
+    srand(seed);
+
+    if (GLOBALS::headless)
+    {
+        if (!RunHeadless(headlessSeconds, seed))
+            exitCode = -1;
+    }
+    else if (!DoTitleScreen())
+        exitCode = -1;
+    else
+    {
+        DoMainMenu();
+
+        if (!PlayGame())
+            exitCode = -1;
+    }
+
+    if (recordFilename && recording.Save(recordFilename))
+        printf("\nrecorded %lu ticks (seed %u) to '%s' in '%s'\n",
+               recording.Ticks(), recording.Seed(), recordFilename, PHYSFS_getWriteDir());
 
-    PlayGame();
+    StopTracing();
 
     ShutdownGame();
     
-    return 0;
+    return exitCode;
 }
+#endif
 
 
 bool InitGame(int __attribute__ ((unused)) argc, char **argv)
@@ -125,17 +268,37 @@ bool InitGame(int __attribute__ ((unused)) argc, char **argv)
     }
 
     al_set_physfs_file_interface();
-    
-    if (!al_install_keyboard())
-        return false;
-    
-    if (!al_install_audio())
+
+    if (!al_init_image_addon())
         return false;
 
-    if (!al_init_acodec_addon())
+    if (GLOBALS::headless)
+    {
+        // everything stays in plain CPU memory, there is no display for video bitmaps to belong to
+        al_set_new_bitmap_flags(ALLEGRO_MEMORY_BITMAP);
+    }
+    else if (!InitDisplay())
         return false;
 
-    al_reserve_samples(3);
+    assetLoader.Add("level", LoadLevel);
+    assetLoader.Add("tile atlas", LoadTileAtlas); // and its collision masks and sprite frames
+
+    // A headless run has nothing to show while it waits, so may as well load everything right here.
+    // Otherwise the title screen is up while the loader thread works (see DoTitleScreen()).
+    if (GLOBALS::headless)
+    {
+        GLOBALS::sound.CreateNull();
+        return assetLoader.LoadNow();
+    }
+
+    return assetLoader.Start();
+}
+
+// keyboard, fonts and the fullscreen display. None of these are needed for headless runs.
+bool InitDisplay(void)
+{
+    if (!al_install_keyboard())
+        return false;
     
     al_init_font_addon();
     al_init_ttf_addon();
@@ -143,16 +306,14 @@ bool InitGame(int __attribute__ ((unused)) argc, char **argv)
     if (!al_init_primitives_addon())
         return false;
 
-    if (!al_init_image_addon())
-        return false;
-
-    al_set_new_display_flags(ALLEGRO_FULLSCREEN | ALLEGRO_OPENGL | ALLEGRO_OPENGL_3_0);
+    // whatever size the desktop is, and the frame gets scaled to fit it
+    al_set_new_display_flags(ALLEGRO_FULLSCREEN_WINDOW | ALLEGRO_OPENGL | ALLEGRO_OPENGL_3_0);
 
     al_set_new_display_option(ALLEGRO_COMPATIBLE_DISPLAY, 1, ALLEGRO_REQUIRE);
     al_set_new_display_option(ALLEGRO_CAN_DRAW_INTO_BITMAP, 1, ALLEGRO_REQUIRE);
     al_set_new_display_option(ALLEGRO_RENDER_METHOD, 1, ALLEGRO_REQUIRE);
     
-    GLOBALS::display = al_create_display(1920, 1080);
+    GLOBALS::display = al_create_display(FRAME_WIDTH_PIXELS_UNSCALED, FRAME_HEIGHT_PIXELS_UNSCALED);
 
     if (GLOBALS::display == NULL)
         return false;
@@ -161,8 +322,10 @@ bool InitGame(int __attribute__ ((unused)) argc, char **argv)
     al_set_new_bitmap_flags(ALLEGRO_VIDEO_BITMAP);
     al_set_new_bitmap_format(ALLEGRO_PIXEL_FORMAT_ANY_WITH_ALPHA);
 
-    GLOBALS::background_scaled = al_create_bitmap(LEVEL_WIDTH_PIXELS_UNSCALED * SCALE_FACTOR, LEVEL_HEIGHT_PIXELS_UNSCALED * SCALE_FACTOR);
-    if (GLOBALS::background_scaled == NULL)
+    if (!GLOBALS::presenter.Create(GLOBALS::display, requestedScale))
+        return false;
+
+    if (!GLOBALS::background.Create())
         return false;
 
     GLOBALS::events = al_create_event_queue();
@@ -170,8 +333,51 @@ bool InitGame(int __attribute__ ((unused)) argc, char **argv)
 
     GLOBALS::defaultFont = al_create_builtin_font();
 
+    return true;
+}
+
+// Slow to start, and not needed until the game is, so left until the title screen is up
+void InitAudio(void)
+{
+    // no sound is no reason not to play
+    if (!al_install_audio() || !al_init_acodec_addon() || !GLOBALS::sound.Create())
+    {
+        fprintf(stderr, "\nWARNING: unable to start audio, the game will be silent");
+        GLOBALS::sound.CreateNull();
+    }
+}
+
+// on the loader thread, while the title screen shows
+bool LoadLevel(TAssetLoader __attribute__ ((unused)) &loader)
+{
+    return GLOBALS::level.Load("level1.lvl");
+}
+
+// On the loader thread (or the main thread, for headless runs), so every bitmap made here is a memory
+// bitmap. The atlas is handed over to be copied into video memory once it's finished with.
+bool LoadTileAtlas(TAssetLoader &loader)
+{
+    ALLEGRO_BITMAP *atlas;
+
+    PHYSFS_uint64 sourceHash;
+
+    if (!HashFile("tiles.png", sourceHash))
+    {
+        fprintf(stderr, "\nERROR: unable to read tilesheet.\n");
+        return false;
+    }
+
+    // prepared on an earlier run, and the tilesheet hasn't changed since
+    atlas = LoadCachedAtlas("tiles.atlas", sourceHash);
+    if (atlas)
+    {
+        loader.QueueUpload(atlas, TileAtlasUploaded);
+        return true;
+    }
+
     // I happen to know that the original Sam tiles are 16x16, so need to do a scaling to get them up to the 32x32 "unscaled" expected size.
     // If they get replaced in the future with natively 32x32 tiles, this initial prescaling would be removed.
+    ALLEGRO_BITMAP *tileAtlas_cells;
     ALLEGRO_BITMAP *tileAtlas_temp = al_load_bitmap("tiles.png");
     if (tileAtlas_temp == NULL)
     {
@@ -179,47 +385,93 @@ bool InitGame(int __attribute__ ((unused)) argc, char **argv)
         return false;
     }
     
-    GLOBALS::tileAtlas_unscaled = al_create_bitmap(al_get_bitmap_width(tileAtlas_temp) * 2, al_get_bitmap_height(tileAtlas_temp) * 2);
-    if (GLOBALS::tileAtlas_unscaled == NULL)
+    tileAtlas_cells = al_create_bitmap(al_get_bitmap_width(tileAtlas_temp) * 2, al_get_bitmap_height(tileAtlas_temp) * 2);
+    if (tileAtlas_cells == NULL)
     {
         fprintf(stderr, "\nERROR: unable to create scaled tilesheet");
         return false;
     }
 
-    al_set_target_bitmap(GLOBALS::tileAtlas_unscaled);
+    al_set_target_bitmap(tileAtlas_cells);
     al_draw_scaled_bitmap(tileAtlas_temp,
         0, 0,
         al_get_bitmap_width(tileAtlas_temp), al_get_bitmap_height(tileAtlas_temp),
         0, 0,
-        al_get_bitmap_width(GLOBALS::tileAtlas_unscaled), al_get_bitmap_height(GLOBALS::tileAtlas_unscaled),
+        al_get_bitmap_width(tileAtlas_cells), al_get_bitmap_height(tileAtlas_cells),
         0);
 
     // done with the original 16x16 tile atlas
     al_destroy_bitmap(tileAtlas_temp);
 
+    // read the atlas once, here, so that collision checks never have to touch the video bitmap
+    if (!BuildCollisionMasks(tileAtlas_cells))
+        return false;
+
+    // trimmed and packed, and from here on only the packed atlas is drawn from
+    atlas = GLOBALS::sprites.Pack(tileAtlas_cells);
+    al_destroy_bitmap(tileAtlas_cells);
+    if (atlas == NULL)
+        return false;
+
+    // so that next time none of the above is needed. Not being able to is no reason not to play.
+    SaveCachedAtlas("tiles.atlas", sourceHash, atlas);
+
+    loader.QueueUpload(atlas, TileAtlasUploaded);
+
     return true;
 }
 
-void PlayGame(void)
+void TileAtlasUploaded(ALLEGRO_BITMAP *atlas)
+{
+    GLOBALS::tileAtlas_unscaled = atlas;
+    GLOBALS::sprites.SetAtlas(atlas);
+}
+
+// False if the game had to stop because the level couldn't be read.
+bool PlayGame(void)
 {
     bool done = false;
-    int i;
     ALLEGRO_EVENT event;
     bool wants_left = false, wants_right = false, wants_jump = false, wants_fire = false;
-    bool remove;
-    std::list<TObject *>::iterator it_remover;
-    double time_of_last_frame = al_get_time();
-    double delta_time;
+    TActionSet actions = 0, wanted;
+    ALLEGRO_THREAD *simulation;
+    const TWorldSnapshot *snapshot, *latest;
+    double interpolation, flipped, latency;
 
-    CreateBackgroundImage( /* level number? */ );
+    // when each input change queued for the simulation happened, until a frame showing it has been flipped
+    std::deque<double> inputTimes;
+    unsigned int inputsShown = 0;
 
     ResetLevel();
 
+    // something to draw until the first tick is done
+    inputQueue.Reset();
+    simulationOver = false;
+    PublishSnapshot(al_get_time());
+    snapshot = snapshots.Take();
+    ApplyTileChanges(*snapshot);
+
+    simulation = al_create_thread(SimulationThread, NULL);
+    if (simulation == NULL)
+    {
+        fprintf(stderr, "\nERROR: unable to start the simulation thread");
+        return false;
+    }
+
+    GLOBALS::sound.PlayMusic("music.ogg");
+
+    al_start_thread(simulation);
+
     while (!done)
     {
-        // NOTE: locked to vsync rate by RedrawScreen() which calls al_flip_display()
+        // NOTE: locked to vsync rate by RedrawScreen() which calls al_flip_display(). The simulation
+        // keeps its own time on its own thread.
+
+        frameTimings.StartFrame();
+        frameTimings.StartPhase(ePHASE_EVENTS);
 
-        if (al_get_next_event(GLOBALS::events, &event))
+        // everything that's happened since the last frame, not just the first of it
+        while (al_get_next_event(GLOBALS::events, &event))
         {
             switch (event.type)
             {
@@ -236,6 +488,10 @@ void PlayGame(void)
                             done = true;
                             break;
 
+                        case ALLEGRO_KEY_F3:
+                            frameTimings.Toggle();
+                            break;
+
                         case ALLEGRO_KEY_LEFT:
                         case ALLEGRO_KEY_PAD_4:
                             wants_left = true;
@@ -280,124 +536,447 @@ void PlayGame(void)
                     break;
                 // TODO: make the keys configurable (remap input option)
             } /* switch(event type) */
+
+            wanted = 0;
+            if (wants_left)
+                wanted |= ACTION_BIT(eACTION_MOVE_LEFT);
+            if (wants_right)
+                wanted |= ACTION_BIT(eACTION_MOVE_RIGHT);
+            if (wants_fire)
+                wanted |= ACTION_BIT(eACTION_FIRE);
+            if (wants_jump)
+                wanted |= ACTION_BIT(eACTION_JUMP);
+
+            // as of when the key went down or up, so the tick that was due then is the one that acts on it
+            if ((wanted != actions) && inputQueue.Push(event.any.timestamp, wanted))
+            {
+                actions = wanted;
+                inputTimes.push_back(event.any.timestamp);
+            }
         }
 
-        // Call the ticks here so that animation frames (and therefore drawing widths) are updated prior to allowing movement,
-        // which relying on the drawing widths for bounds-checking 
-        delta_time = al_get_time() - time_of_last_frame;
-        time_of_last_frame = al_get_time();
+        frameTimings.StopPhase(ePHASE_EVENTS);
+
+        // the game is over once a replay runs out
+        if (simulationOver)
+            done = true;
 
-        GLOBALS::player.Tick(delta_time);
-        for (std::list<TObject *>::iterator it = GLOBALS::interactives.begin(); it != GLOBALS::interactives.end(); ++it)
+        // the latest world the simulation has finished, if there's been a new one since the last frame
+        latest = snapshots.Take();
+        if (latest)
         {
-            assert(*it);
-            (*it)->Tick(delta_time);
+            snapshot = latest;
+            ApplyTileChanges(*snapshot);
+
+            for (unsigned int phase = 0; phase < ePHASE_COUNT; ++phase)
+                frameTimings.AddPhase(TFramePhase(phase), snapshot->phaseSeconds[phase]);
         }
 
-        if (wants_left)
-            ProcessAction(eACTION_MOVE_LEFT);
-        if (wants_right)
-            ProcessAction(eACTION_MOVE_RIGHT);
-        if (wants_fire)
-            ProcessAction(eACTION_FIRE);
-        if (wants_jump)
-            ProcessAction(eACTION_JUMP);
+        // whatever the ticks made a noise about
+        GLOBALS::sound.Update();
 
+        // draw partway between the snapshot's last two ticks, by how far real time has got towards the next one
+        interpolation = (al_get_time() - snapshot->time) / SIMULATION_TICK_SECONDS;
+        RedrawScreen(*snapshot, max(0.0, min(1.0, interpolation)));
+        flipped = al_get_time();
 
-        // check for collisions
-        for (std::list<TObject *>::iterator it = GLOBALS::interactives.begin(); it != GLOBALS::interactives.end(); ++it)
+        // the input the simulation had acted on by this snapshot is on the screen now
+        latency = -1.0;
+        for (; (inputsShown < snapshot->inputsTaken) && !inputTimes.empty(); ++inputsShown)
         {
-            assert(*it);
-
-            if (ObjectCollide(*it, &(GLOBALS::player)))
-            {                
-                remove = (*it)->CollidedWith(GLOBALS::player);
-
-                if (remove)
-                {
-                    // remove the object from the interactives list. It was a one-shot interaction
-                    it_remover = it;
-                    --it; // back up the iterator, since it will be incremented by the for() loop
-                          // after this, it points to the item before it_remover.
-                    GLOBALS::interactives.erase(it_remover);
-                          // now it_remover (the colliding object) has been removed from the list
-                          // so when the for() loop increments the iterator, it will point to the
-                          // item after colliding object that was just removed from the list
-                    delete (*it_remover);
-                }
-            }
+            latency = max(latency, flipped - inputTimes.front());
+            inputTimes.pop_front();
+        }
 
-            //if (there is an active shot)
-                // if it collided with the object
-                    // call CollidedWith(shot)
+        if (latency >= 0.0)
+        {
+            frameTimings.AddInputLatency(latency);
+            TRACE_INFO("input latency", "ms", latency * 1000.0, NULL, 0);
         }
 
-        if (InDeathSquare())
+        frameTimings.EndFrame();
+    } /* while(!bDone) */
+
+    // joining asks it to stop, too
+    al_join_thread(simulation, NULL);
+    al_destroy_thread(simulation);
+
+    GLOBALS::sound.StopMusic();
+
+    return !GLOBALS::level.ReadFailed();
+}
+
+// Runs each tick once real time gets to when it's due, and publishes the world it leaves behind.
+// Sleeps in between, so it can take as long as it likes to notice it's been asked to stop.
+void *SimulationThread(ALLEGRO_THREAD *thread, void __attribute__ ((unused)) *arg)
+{
+    double nextTick = al_get_time() + SIMULATION_TICK_SECONDS;
+    double now;
+    TActionSet actions;
+
+    while (!al_get_thread_should_stop(thread))
+    {
+        now = al_get_time();
+        if (now < nextTick)
         {
-            ResetLevel();
+            al_rest(nextTick - now);
             continue;
         }
 
+        // after a hitch (debugger, window being dragged, ...) just let the game run slow for a moment
+        // rather than trying to catch up with a huge burst of ticks
+        if ((now - nextTick) > MAX_FRAME_SECONDS)
+            nextTick = now - MAX_FRAME_SECONDS;
+
+        // the keys as they were when this tick was due, which may be a little before now
+        actions = inputQueue.ActionsAt(nextTick);
 
-        // player is either jumping or falling
-        if (GLOBALS::player.m_jumping)
+        if (!ActionsForTick(actions))
         {
-            // only increase upward velocity every fourth frame so that the player can jump farther
-            // horizontally before having reaching PLAYER_MAX_JUMP_HEIGHT_UNSCALED without increasing
-            // how high the player can jump
-            //if (!(GLOBALS::player.m_jumpedSoFar & 3))
-            {
-                // velocity starts out at max and slows down as jump progresses to form
-                // something slightly resembling parabolic motion
-                if (GLOBALS::player.m_yVelocity > 4)
-                    GLOBALS::player.m_yVelocity -= 2;
-                    // but never let velocity get to zero because then we'd never finish
-                    // jumping
-            }
+            simulationOver = true;
+            break;
+        }
+
+        if (!SimulateTick(actions))
+        {
+            simulationOver = true;
+            break;
+        }
+        PublishSnapshot(nextTick);
+
+        nextTick += SIMULATION_TICK_SECONDS;
+    }
 
-            for (i = 0; i < GLOBALS::player.m_yVelocity; ++i)
+    return NULL;
+}
+
+// Swaps in the replayed actions when replaying, and records them when recording.
+// Returns false once there are no ticks left to replay.
+bool ActionsForTick(TActionSet &actions)
+{
+    if (replaying)
+        return replay.Playback(actions);
+
+    if (recordFilename)
+        recording.Record(actions);
+
+    return true;
+}
+
+// False, having done nothing, if the level can't be read any more.
+bool SimulateTick(TActionSet actions)
+{
+    // kept between ticks so they don't have to be reallocated every time
+    static std::vector<TInteractiveRef> nearby, doomed;
+    signed int worldX, worldY;
+
+    TRACE_BEGIN("tick");
+
+    memset(tickPhaseSeconds, 0, sizeof(tickPhaseSeconds));
+
+    // have the level around the player in memory before anything looks at it. This also notices any
+    // chunk that failed to read during the last tick.
+    if (!GLOBALS::level.Stream(GLOBALS::player.m_x, GLOBALS::player.m_y))
+    {
+        TRACE_END("tick");
+        return false;
+    }
+
+    // only what's around the camera does anything this tick; not the player, who is off centre at the level's edges
+    CameraPosition(GLOBALS::player.m_x, GLOBALS::player.m_y, GLOBALS::level.WidthPixels(), GLOBALS::level.HeightPixels(), worldX, worldY);
+    GLOBALS::interactives.Activate(worldX + (VIEWPORT_WIDTH_PIXELS_UNSCALED / 2), worldY + (VIEWPORT_HEIGHT_PIXELS_UNSCALED / 2));
+
+    GLOBALS::player.StorePreviousPosition();
+    GLOBALS::interactives.StorePreviousPositions();
+
+    // Call the ticks here so that animation frames (and therefore drawing widths) are updated prior to allowing movement,
+    // which relying on the drawing widths for bounds-checking
+    StartTickPhase();
+    GLOBALS::player.Tick(SIMULATION_TICK_SECONDS);
+    StopTickPhase(ePHASE_PLAYER_TICK);
+
+    StartTickPhase();
+    GLOBALS::interactives.Tick(SIMULATION_TICK_SECONDS);
+    StopTickPhase(ePHASE_INTERACTIVES_TICK);
+
+    // acting on input is part of the player's tick
+    StartTickPhase();
+    if (actions & ACTION_BIT(eACTION_MOVE_LEFT))
+        GLOBALS::player.ProcessAction(eACTION_MOVE_LEFT);
+    if (actions & ACTION_BIT(eACTION_MOVE_RIGHT))
+        GLOBALS::player.ProcessAction(eACTION_MOVE_RIGHT);
+    if (actions & ACTION_BIT(eACTION_FIRE))
+        GLOBALS::player.ProcessAction(eACTION_FIRE);
+    if (actions & ACTION_BIT(eACTION_JUMP))
+        GLOBALS::player.ProcessAction(eACTION_JUMP);
+    StopTickPhase(ePHASE_PLAYER_TICK);
+
+
+    // check for collisions, but only against what the broadphase grid says is nearby.
+    // Anything that needs removing is only collected here and destroyed once all the checks are done.
+    StartTickPhase();
+    doomed.clear();
+
+    nearby.clear();
+    GLOBALS::interactives.Query(GLOBALS::player.m_x, GLOBALS::player.m_y, TILE_WIDTH_PIXELS_UNSCALED, TILE_HEIGHT_PIXELS_UNSCALED, nearby);
+    for (std::vector<TInteractiveRef>::iterator it = nearby.begin(); it != nearby.end(); ++it)
+    {
+        // a true result means it was a one-shot interaction
+        if (ObjectCollide(GLOBALS::interactives.TileID(*it), GLOBALS::interactives.X(*it), GLOBALS::interactives.Y(*it),
+                          GLOBALS::player.TileID(), GLOBALS::player.m_x, GLOBALS::player.m_y) &&
+            GLOBALS::interactives.PlayerTouched(*it))
+            doomed.push_back(*it);
+    }
+
+    const TInteractivePool &bullets = GLOBALS::interactives.Pool(eINTERACTIVE_BULLET);
+    for (unsigned int shot = 0; shot < bullets.Count(); ++shot)
+    {
+        const TInteractiveRef shotRef = MakeInteractiveRef(eINTERACTIVE_BULLET, shot);
+
+        nearby.clear();
+        GLOBALS::interactives.Query(bullets.x[shot], bullets.y[shot], TILE_WIDTH_PIXELS_UNSCALED, TILE_HEIGHT_PIXELS_UNSCALED, nearby);
+        for (std::vector<TInteractiveRef>::iterator it = nearby.begin(); it != nearby.end(); ++it)
+        {
+            if ((*it != shotRef) &&
+                ObjectCollide(GLOBALS::interactives.TileID(*it), GLOBALS::interactives.X(*it), GLOBALS::interactives.Y(*it),
+                              bullets.tileID[shot], bullets.x[shot], bullets.y[shot]))
             {
-                if (CanMoveUp())
-                {
-                    GLOBALS::player.m_y -= 1;
-                    GLOBALS::player.m_jumpedSoFar += 1;
+                if (GLOBALS::interactives.ShotHit(*it))
+                    doomed.push_back(*it);
 
-                    if (GLOBALS::player.m_jumpedSoFar >= PLAYER_MAX_JUMP_HEIGHT_UNSCALED)
-                    {
-                        GLOBALS::player.m_jumping = false;
-                        GLOBALS::player.m_yVelocity = 0;
-                    }
-                }
-                else // solid blocks above
-                {
-                    GLOBALS::player.m_jumping = false;
-                    GLOBALS::player.m_yVelocity = 0;
-                }
+                // bullets are always removed when they hit something
+                doomed.push_back(shotRef);
+                break;
             }
         }
-        else // try to apply gravity
+    }
+
+    GLOBALS::interactives.Destroy(doomed);
+    StopTickPhase(ePHASE_COLLISION);
+
+    StartTickPhase();
+    if (InDeathSquare())
+    {
+        GLOBALS::sound.Post(eSOUND_DEATH);
+        ResetLevel();
+    }
+    StopTickPhase(ePHASE_DEATH_CHECK);
+
+    TRACE_END("tick");
+
+    return true;
+}
+
+// Times the simulation's phases on its own thread, for the next snapshot to carry. Only while the overlay
+// is showing them, like TFrameTimings.
+void StartTickPhase(void)
+{
+    tickPhaseStart = frameTimings.Visible() ? al_get_time() : 0.0;
+}
+
+void StopTickPhase(TFramePhase phase)
+{
+    // the overlay may have been turned on since the phase started
+    if (tickPhaseStart != 0.0)
+        tickPhaseSeconds[phase] += al_get_time() - tickPhaseStart;
+}
+
+// Hands the display the world as of the tick that was due at time (as in al_get_time()).
+void PublishSnapshot(double time)
+{
+    // kept between calls so it doesn't have to be reallocated every time
+    static std::vector<TTileRect> changed;
+    TWorldSnapshot &snapshot = snapshots.Back();
+    const TTileRect window = TileWindow();
+
+    // Snapshots only need their tiles copied again if a change is somewhere they have tiles for. One with
+    // a different window is recopied anyway.
+    GLOBALS::level.TakeDirtyRects(changed);
+    for (std::vector<TTileRect>::const_iterator it = changed.begin(); it != changed.end(); ++it)
+    {
+        if ((it->left <= window.right) && (it->right >= window.left) && (it->top <= window.bottom) && (it->bottom >= window.top))
         {
-            for (i = 0; (i < GLOBALS::player.m_yVelocity) && (!OnSolidGround()); ++i)
+            ++tilesVersion;
+            break;
+        }
+    }
+
+    FillSnapshot(snapshot, time);
+    snapshot.inputsTaken = inputQueue.Taken();
+
+    // everything since the last snapshot the display is known to have taken
+    unseenTileChanges.insert(unseenTileChanges.end(), changed.begin(), changed.end());
+    snapshot.dirty = unseenTileChanges;
+
+    // When the display has taken the snapshot before this one, only this one's changes can still be
+    // unseen. Otherwise they all can, and the next snapshot carries them too.
+    if (!snapshots.Publish())
+        unseenTileChanges = changed;
+}
+
+void FillSnapshot(TWorldSnapshot &snapshot, double time)
+{
+    // kept between calls so it doesn't have to be reallocated every time
+    static std::vector<TInteractiveRef> nearby;
+    signed int worldX, worldY;
+    signed int tileX, tileY;
+    TSpriteSnapshot sprite;
+
+    snapshot.time = time;
+    snapshot.levelWidthTiles = GLOBALS::level.WidthTiles();
+    snapshot.levelHeightTiles = GLOBALS::level.HeightTiles();
+
+    snapshot.player.tileID = GLOBALS::player.TileID();
+    snapshot.player.x = GLOBALS::player.m_x;
+    snapshot.player.y = GLOBALS::player.m_y;
+    snapshot.player.previousX = GLOBALS::player.InterpolatedX(0.0);
+    snapshot.player.previousY = GLOBALS::player.InterpolatedY(0.0);
+
+    CameraPosition(GLOBALS::player.m_x, GLOBALS::player.m_y, GLOBALS::level.WidthPixels(), GLOBALS::level.HeightPixels(), worldX, worldY);
+
+    // everything that could be on screen, with a tile to spare for wherever the camera is drawn from
+    // between the last two ticks
+    nearby.clear();
+    GLOBALS::interactives.Query(worldX - TILE_WIDTH_PIXELS_UNSCALED, worldY - TILE_HEIGHT_PIXELS_UNSCALED,
+                                VIEWPORT_WIDTH_PIXELS_UNSCALED  + (TILE_WIDTH_PIXELS_UNSCALED * 2),
+                                VIEWPORT_HEIGHT_PIXELS_UNSCALED + (TILE_HEIGHT_PIXELS_UNSCALED * 2), nearby);
+
+    // refs sort by kind, then by index, so this walks each pool's arrays front to back
+    std::sort(nearby.begin(), nearby.end());
+
+    snapshot.sprites.clear();
+    for (std::vector<TInteractiveRef>::iterator it = nearby.begin(); it != nearby.end(); ++it)
+    {
+        const TInteractivePool &pool = GLOBALS::interactives.Pool(KindOfRef(*it));
+        const unsigned int index = IndexOfRef(*it);
+
+        sprite.tileID = pool.tileID[index];
+        sprite.x = pool.x[index];
+        sprite.y = pool.y[index];
+        sprite.previousX = pool.previousX[index];
+        sprite.previousY = pool.previousY[index];
+        snapshot.sprites.push_back(sprite);
+    }
+
+    const TTileRect window = TileWindow();
+
+    // unless this snapshot already has them, from the last time it was filled in
+    if ((snapshot.windowVersion != tilesVersion) ||
+        (snapshot.window.left != window.left) || (snapshot.window.top != window.top) ||
+        (snapshot.window.right != window.right) || (snapshot.window.bottom != window.bottom))
+    {
+        snapshot.window = window;
+        snapshot.windowVersion = tilesVersion;
+        snapshot.backTiles.clear();
+        snapshot.midTiles.clear();
+
+        for (tileY = window.top; tileY <= window.bottom; ++tileY)
+        {
+            for (tileX = window.left; tileX <= window.right; ++tileX)
             {
-                GLOBALS::player.m_y += 1;
+                snapshot.backTiles.push_back(GLOBALS::level.Tile(eLAYER_BACK_TILES, tileX, tileY));
+
+                // anything that was spawned as an interactive draws itself
+                snapshot.midTiles.push_back(SpawnsInteractive(GLOBALS::level.Tile(eLAYER_CODES, tileX, tileY)) ?
+                                            -1 : GLOBALS::level.Tile(eLAYER_MID_TILES, tileX, tileY));
             }
+        }
+    }
+
+    snapshot.score = GLOBALS::player.Score();
+    snapshot.ammo = GLOBALS::player.Ammo();
+
+    snapshot.playerState = GLOBALS::player.StateAsString();
+    snapshot.onGround = OnSolidGround();
+    snapshot.awake = GLOBALS::interactives.AwakeCount();
+
+    memcpy(snapshot.phaseSeconds, tickPhaseSeconds, sizeof(snapshot.phaseSeconds));
+}
 
-            // player falls faster the farther they fall (up to a terminal velocity)
-            ++(GLOBALS::player.m_yVelocity);
-            if (GLOBALS::player.m_yVelocity >= GLOBALS::player.m_yVelocityMax)
-                GLOBALS::player.m_yVelocity = GLOBALS::player.m_yVelocityMax;
+// Runs the simulation with no display, no input and no waiting on vsync, so game time goes by as fast as
+// the CPU allows. The player is driven by a replay if there is one, otherwise by random combinations of
+// actions, each held for a random number of ticks. False if it had to stop because the level couldn't be read.
+bool RunHeadless(double seconds, unsigned int seed)
+{
+    // a replay runs for as long as it was recorded for
+    const unsigned long maxTicks = replaying ? replay.Ticks() : (unsigned long)(seconds * SIMULATION_TICKS_PER_SECOND);
+    unsigned long ticks, ticksUntilNewActions = 0;
+    TActionSet actions = 0;
+    double startTime, elapsedSeconds;
+    std::vector<TTileRect> changed;
+
+    // The random driver has a generator of its own so that it doesn't use up numbers from rand(),
+    // otherwise the game would see a different sequence when this run is replayed.
+    unsigned int driverRandom = seed | 1;
+
+    ResetLevel();
+
+    startTime = al_get_time();
+
+    for (ticks = 0; ticks < maxTicks; ++ticks)
+    {
+        if (ticksUntilNewActions == 0)
+        {
+            // xorshift
+            driverRandom ^= driverRandom << 13;
+            driverRandom ^= driverRandom >> 17;
+            driverRandom ^= driverRandom << 5;
+
+            actions = driverRandom % ACTION_BIT(eACTION_COUNT);
+            ticksUntilNewActions = 1 + ((driverRandom >> 8) % SIMULATION_TICKS_PER_SECOND);
         }
+        --ticksUntilNewActions;
 
-        // No more vertical motion possible? then update velocity accordingly.
-        if (OnSolidGround() && !(GLOBALS::player.m_jumping))
-            GLOBALS::player.m_yVelocity = 0;
+        if (!ActionsForTick(actions) || !SimulateTick(actions))
+            break;
 
-        RedrawScreen();
-    } /* while(!bDone) */
+        // nothing to hear or see, but the sound queue and the tile changes still need emptying
+        GLOBALS::sound.Update();
+        GLOBALS::level.TakeDirtyRects(changed);
+    }
+
+    elapsedSeconds = al_get_time() - startTime;
+
+    printf("\nheadless: simulated %lu ticks (%.1f seconds of game time) in %.3f seconds",
+           ticks, ticks * SIMULATION_TICK_SECONDS, elapsedSeconds);
+    if (elapsedSeconds > 0.0)
+        printf(", %.0f ticks per second", ticks / elapsedSeconds);
+    printf("\nheadless: player finished at (%.1f, %.1f) in state %s with score %u and %u ammo\n",
+           GLOBALS::player.m_x, GLOBALS::player.m_y, GLOBALS::player.StateAsString(),
+           GLOBALS::player.Score(), GLOBALS::player.Ammo());
+
+    return !GLOBALS::level.ReadFailed();
 }
 
-void DoTitleScreen(void)
+// Shows the title screen for as long as the loader takes, putting what it has loaded into video memory
+// a little at a time between frames so that the screen keeps updating. False if anything failed to load.
+bool DoTitleScreen(void)
 {
+    // something on screen before anything else
+    al_set_target_bitmap(GLOBALS::presenter.Frame());
+    DrawTitleScreen(0.0f);
+    GLOBALS::presenter.Present();
+    al_flip_display();
+
+    InitAudio();
+
+    // NOTE: locked to vsync rate by al_flip_display()
+    while (!assetLoader.Finished())
+    {
+        assetLoader.Upload(UPLOADS_PER_FRAME);
+
+        al_set_target_bitmap(GLOBALS::presenter.Frame());
+        DrawTitleScreen(assetLoader.Progress());
+        GLOBALS::presenter.Present();
+        al_flip_display();
+    }
+
+    if (!assetLoader.Finish())
+        return false;
+
+    // keys pressed while loading weren't meant for the game
+    al_flush_event_queue(GLOBALS::events);
+
     // TODO: title screen
     //    load title screen bitmap
     //    load title screen music
@@ -407,6 +986,24 @@ void DoTitleScreen(void)
     //    stop music
     //    unload music
     //    unload bitmap
+
+    return true;
+}
+
+void DrawTitleScreen(float progress)
+{
+    const float barLeft  = FRAME_WIDTH_PIXELS_UNSCALED / 4;
+    const float barRight = FRAME_WIDTH_PIXELS_UNSCALED - barLeft;
+    const float barTop   = (FRAME_HEIGHT_PIXELS_UNSCALED / 2) + TILE_HEIGHT_PIXELS_UNSCALED;
+
+    al_clear_to_color(al_map_rgb(0,0,0));
+
+    al_draw_text(GLOBALS::defaultFont, al_map_rgb(255,255,255), FRAME_WIDTH_PIXELS_UNSCALED / 2, FRAME_HEIGHT_PIXELS_UNSCALED / 2,
+                 ALLEGRO_ALIGN_CENTRE, "SECRET AGENT");
+
+    al_draw_filled_rectangle(barLeft, barTop, barLeft + ((barRight - barLeft) * progress), barTop + (TILE_HEIGHT_PIXELS_UNSCALED / 4),
+                             al_map_rgb(10,10,150));
+    al_draw_rectangle(barLeft, barTop, barRight, barTop + (TILE_HEIGHT_PIXELS_UNSCALED / 4), al_map_rgb(255,255,255), 1);
 }
 
 void DoMainMenu(void)
@@ -424,164 +1021,152 @@ void DoMainMenu(void)
     //    unload bitmap
 }
 
-void RedrawScreen(void)
+void RedrawScreen(const TWorldSnapshot &snapshot, double interpolation)
 {
-    // unscaled!
-    signed int worldX, worldY;
+    TRACE_BEGIN("draw");
 
-    al_set_target_backbuffer(GLOBALS::display);
+    al_set_target_bitmap(GLOBALS::presenter.Frame());
 
+    DrawFrame(snapshot, interpolation);
 
-    // keep viewable region centered around the player if possible. This means the level is split into three
-    // regions:
+    frameTimings.StartPhase(ePHASE_PRESENT);
+    GLOBALS::presenter.Present();
+    frameTimings.StopPhase(ePHASE_PRESENT);
 
-    //   - player is in middle of level (so enough left and right to center about player)
-    worldX = (GLOBALS::player.m_x + (TILE_WIDTH_PIXELS_UNSCALED / 2)) - (VIEWPORT_WIDTH_PIXELS_UNSCALED / 2);
-    worldY = (GLOBALS::player.m_y + (TILE_HEIGHT_PIXELS_UNSCALED / 2)) - (VIEWPORT_HEIGHT_PIXELS_UNSCALED / 2);
+    // at the display's resolution, on top of the scaled frame
+    if (frameTimings.Visible())
+        DrawDebugOverlay(snapshot);
 
-    //   - player is too far left to center level (not enough world to the left of the player)
-    if (worldX < 0)
-        worldX = 0;
-    //   - player is too far right to center level (not enough world to the right of the player)
-    else if (worldX > (LEVEL_WIDTH_PIXELS_UNSCALED - VIEWPORT_WIDTH_PIXELS_UNSCALED))
-        worldX = LEVEL_WIDTH_PIXELS_UNSCALED - VIEWPORT_WIDTH_PIXELS_UNSCALED;
+    frameTimings.StartPhase(ePHASE_FLIP);
+    al_flip_display();
+    frameTimings.StopPhase(ePHASE_FLIP);
 
+    TRACE_END("draw");
+}
 
-    if (worldY < 0)
-        worldY = 0;
-    else if (worldY > (LEVEL_HEIGHT_PIXELS_UNSCALED - VIEWPORT_HEIGHT_PIXELS_UNSCALED))
-        worldY = LEVEL_HEIGHT_PIXELS_UNSCALED - VIEWPORT_HEIGHT_PIXELS_UNSCALED;
-
-
-    //    copy appropriate region of background bitmap to screen
-    al_draw_bitmap_region(GLOBALS::background_scaled, worldX * SCALE_FACTOR, worldY * SCALE_FACTOR, /* source x, y */
-                                                      SCREEN_WIDTH_PIXELS_SCALED, SCREEN_HEIGHT_PIXELS_SCALED, /* width, height */
-                                                      0, 0, /* dest x, y */
-                                                      0);
-
-    // draw the player
-    const unsigned int playerTileID = GLOBALS::player.TileID();
-    const unsigned int atlasWidth_tiles = al_get_bitmap_width(GLOBALS::tileAtlas_unscaled) / TILE_WIDTH_PIXELS_UNSCALED;
-    al_draw_scaled_bitmap(GLOBALS::tileAtlas_unscaled,
-                                      (playerTileID % atlasWidth_tiles) * TILE_WIDTH_PIXELS_UNSCALED, (playerTileID / atlasWidth_tiles) * TILE_HEIGHT_PIXELS_UNSCALED,
-                                      TILE_WIDTH_PIXELS_UNSCALED, TILE_HEIGHT_PIXELS_UNSCALED,
-                                      (GLOBALS::player.m_x - worldX) * SCALE_FACTOR, (GLOBALS::player.m_y - worldY) * SCALE_FACTOR,
-                                      TILE_WIDTH_PIXELS_UNSCALED * SCALE_FACTOR, TILE_HEIGHT_PIXELS_UNSCALED * SCALE_FACTOR,
-                                      0);
-
-    // and all the interactives
-    unsigned int tileID;
-    signed int x, y;
-    for (std::list<TObject *>::iterator it = GLOBALS::interactives.begin(); it != GLOBALS::interactives.end(); ++it)
-    {
-        assert(*it);
+void DrawFrame(const TWorldSnapshot &snapshot, double interpolation)
+{
+    // unscaled!
+    signed int worldX, worldY;
 
-        tileID = (*it)->TileID();
-        x = (*it)->m_x;
-        y = (*it)->m_y;
-        unsigned int relativeX_unscaled = x - worldX;
-        unsigned int relativeX_scaled = relativeX_unscaled * SCALE_FACTOR;
+    // where the player is drawn, somewhere between its last two simulated positions
+    const double playerX = snapshot.player.InterpolatedX(interpolation);
+    const double playerY = snapshot.player.InterpolatedY(interpolation);
 
-        // only draw the thing if it is currently on the screen
-        if (relativeX_scaled < SCREEN_WIDTH_PIXELS_SCALED)
-        {
-            // TODO: only draw the visible portion, not the whole tile
-
-            al_draw_scaled_bitmap(GLOBALS::tileAtlas_unscaled,
-                                  (tileID % atlasWidth_tiles) * TILE_WIDTH_PIXELS_UNSCALED, (tileID / atlasWidth_tiles) * TILE_HEIGHT_PIXELS_UNSCALED,
-                                  TILE_WIDTH_PIXELS_UNSCALED, TILE_HEIGHT_PIXELS_UNSCALED,
-                                  (x - worldX) * SCALE_FACTOR, (y - worldY) * SCALE_FACTOR,
-                                  TILE_WIDTH_PIXELS_UNSCALED * SCALE_FACTOR, TILE_HEIGHT_PIXELS_UNSCALED * SCALE_FACTOR,
-                                  0);
-        }
-    }
+    CameraPosition(playerX, playerY, snapshot.levelWidthTiles * TILE_WIDTH_PIXELS_UNSCALED, snapshot.levelHeightTiles * TILE_HEIGHT_PIXELS_UNSCALED,
+                   worldX, worldY);
 
-    // TODO: copy appropriate region of foreground bitmap to screen (eventually, if there is one)
+    //    copy the visible chunks of the background to screen
+    frameTimings.StartPhase(ePHASE_BACKGROUND);
+    GLOBALS::background.Draw(snapshot, worldX, worldY);
+    frameTimings.StopPhase(ePHASE_BACKGROUND);
 
+    // draw the player, and all the sprites after it, in one batch
+    frameTimings.StartPhase(ePHASE_SPRITES);
+    GLOBALS::sprites.BeginBatch();
+    GLOBALS::sprites.Draw(snapshot.player.tileID, playerX - worldX, playerY - worldY);
 
-    // display some debugging information
-#if 0
-    al_draw_textf(GLOBALS::defaultFont, al_map_rgb(255,255,255), TILE_WIDTH_PIXELS_UNSCALED * SCALE_FACTOR, TILE_HEIGHT_PIXELS_UNSCALED, 0,
-                  "onGround(%d) canMoveUp(%d), jumping(%d)",
-                  OnSolidGround(), CanMoveUp(), GLOBALS::player.m_jumping);
-#endif
+    // and all the interactives that are around the screen
+    signed int x, y;
 
-    // fill with black any parts of the screen our view doesn't fill
-    signed int unfilled_height = al_get_display_height(GLOBALS::display) - SCREEN_HEIGHT_PIXELS_SCALED;
-    signed int unfilled_width = al_get_display_width(GLOBALS::display) - SCREEN_WIDTH_PIXELS_SCALED;
+    for (std::vector<TSpriteSnapshot>::const_iterator it = snapshot.sprites.begin(); it != snapshot.sprites.end(); ++it)
+    {
+        x = it->InterpolatedX(interpolation);
+        y = it->InterpolatedY(interpolation);
 
-    if (unfilled_height > 0)
-        al_draw_filled_rectangle(0, SCREEN_HEIGHT_PIXELS_SCALED, al_get_display_width(GLOBALS::display), al_get_display_height(GLOBALS::display), al_map_rgb(0,0,0));
+        // TODO: only draw the visible portion, not the whole tile
+        GLOBALS::sprites.Draw(it->tileID, x - worldX, y - worldY);
+    }
 
-    if (unfilled_width > 0)
-        al_draw_filled_rectangle(SCREEN_WIDTH_PIXELS_SCALED, 0, al_get_display_width(GLOBALS::display), al_get_display_height(GLOBALS::display), al_map_rgb(0,0,0));
+    GLOBALS::sprites.EndBatch();
+    frameTimings.StopPhase(ePHASE_SPRITES);
 
-    DrawStatusBar();
+    // TODO: copy appropriate region of foreground bitmap to screen (eventually, if there is one)
 
-    al_flip_display();
+    frameTimings.StartPhase(ePHASE_STATUS_BAR);
+    DrawStatusBar(snapshot);
+    frameTimings.StopPhase(ePHASE_STATUS_BAR);
 }
 
-void ProcessAction(action_t action)
+// The tiles a snapshot copies: the background chunks the camera is in as of the latest tick, and the ones
+// close enough for TBackgroundCache::Draw() to render ahead. That's never more than KEEP_RADIUS_CHUNKS level
+// chunks from the player, so copying them never has to read chunks in that Stream() would drop again.
+TTileRect TileWindow(void)
 {
-    int tileX, tileYtop, tileYbottom, i;
+    signed int worldX, worldY;
 
-    tileYtop = GLOBALS::player.m_y / TILE_HEIGHT_PIXELS_UNSCALED;
-    tileYbottom = (GLOBALS::player.m_y + TILE_HEIGHT_PIXELS_UNSCALED - 1) / TILE_HEIGHT_PIXELS_UNSCALED;
+    CameraPosition(GLOBALS::player.m_x, GLOBALS::player.m_y, GLOBALS::level.WidthPixels(), GLOBALS::level.HeightPixels(), worldX, worldY);
 
-    // IMPORTANT: ALL MOVEMENTS ARE PERFORMED IN THE UNSCALED PIXEL WORLD
-    switch (action)
-    {
-        case eACTION_MOVE_LEFT:
-            GLOBALS::player.m_facing = eFACING_LEFT;
+    const signed int nearLeft   = max(0, worldX - TBackgroundCache::APPROACH_PIXELS) / VIEWPORT_WIDTH_PIXELS_UNSCALED;
+    const signed int nearTop    = max(0, worldY - TBackgroundCache::APPROACH_PIXELS) / VIEWPORT_HEIGHT_PIXELS_UNSCALED;
+    const signed int nearRight  = (worldX + VIEWPORT_WIDTH_PIXELS_UNSCALED  + TBackgroundCache::APPROACH_PIXELS - 1) / VIEWPORT_WIDTH_PIXELS_UNSCALED;
+    const signed int nearBottom = (worldY + VIEWPORT_HEIGHT_PIXELS_UNSCALED + TBackgroundCache::APPROACH_PIXELS - 1) / VIEWPORT_HEIGHT_PIXELS_UNSCALED;
+    const TTileRect window = { nearLeft * VIEWPORT_WIDTH_TILES,
+                               nearTop  * VIEWPORT_HEIGHT_TILES,
+                               min(GLOBALS::level.WidthTiles(),  (nearRight  + 1) * VIEWPORT_WIDTH_TILES)  - 1,
+                               min(GLOBALS::level.HeightTiles(), (nearBottom + 1) * VIEWPORT_HEIGHT_TILES) - 1 };
 
+    return window;
+}
 
-            for (i = 0; i < GLOBALS::player.m_xVelocity; ++i)
-            {
-                tileX = max(0, GLOBALS::player.m_x - 1) / TILE_WIDTH_PIXELS_UNSCALED;
+// the top left of the viewport (unscaled pixels) with the player at playerX, playerY
+void CameraPosition(double playerX, double playerY, signed int levelWidthPixels, signed int levelHeightPixels,
+                    signed int &worldX, signed int &worldY)
+{
+    // keep viewable region centered around the player if possible. This means the level is split into three
+    // regions:
 
-                if (!(level1MapData.bounds[tileYtop    * LEVEL_WIDTH_TILES + tileX] & SOLID_RIGHT) &&
-                    !(level1MapData.bounds[tileYbottom * LEVEL_WIDTH_TILES + tileX] & SOLID_RIGHT))
-                    GLOBALS::player.m_x -= 1;
-                else
-                    break;
-            }
-            break;
+    //   - player is in middle of level (so enough left and right to center about player)
+    worldX = (playerX + (TILE_WIDTH_PIXELS_UNSCALED / 2)) - (VIEWPORT_WIDTH_PIXELS_UNSCALED / 2);
+    worldY = (playerY + (TILE_HEIGHT_PIXELS_UNSCALED / 2)) - (VIEWPORT_HEIGHT_PIXELS_UNSCALED / 2);
 
-        case eACTION_MOVE_RIGHT:
-            GLOBALS::player.m_facing = eFACING_RIGHT;
+    //   - player is too far left to center level (not enough world to the left of the player)
+    if (worldX < 0)
+        worldX = 0;
+    //   - player is too far right to center level (not enough world to the right of the player)
+    else if (worldX > (levelWidthPixels - VIEWPORT_WIDTH_PIXELS_UNSCALED))
+        worldX = levelWidthPixels - VIEWPORT_WIDTH_PIXELS_UNSCALED;
 
-            for (i = 0; i < GLOBALS::player.m_xVelocity; ++i)
-            {
-                tileX = min(LEVEL_WIDTH_PIXELS_UNSCALED - 1, GLOBALS::player.m_x + GLOBALS::player.DrawWidth()) / TILE_WIDTH_PIXELS_UNSCALED;
 
-                if (!(level1MapData.bounds[tileYtop    * LEVEL_WIDTH_TILES + tileX] & SOLID_LEFT) &&
-                    !(level1MapData.bounds[tileYbottom * LEVEL_WIDTH_TILES + tileX] & SOLID_LEFT))
-                    GLOBALS::player.m_x += 1;
-                else
-                    break;
-            }
-            break;
+    if (worldY < 0)
+        worldY = 0;
+    else if (worldY > (levelHeightPixels - VIEWPORT_HEIGHT_PIXELS_UNSCALED))
+        worldY = levelHeightPixels - VIEWPORT_HEIGHT_PIXELS_UNSCALED;
+}
 
-        case eACTION_JUMP:
-            if ((!GLOBALS::player.m_jumping) && OnSolidGround())
-            {
-                GLOBALS::player.m_jumping = true;
-                GLOBALS::player.m_jumpedSoFar = 0;
-                GLOBALS::player.m_yVelocity = GLOBALS::player.m_yVelocityMax;
-            }
+void DrawDebugOverlay(const TWorldSnapshot &snapshot)
+{
+    const signed int height = al_get_bitmap_height(al_get_target_bitmap());
 
-            break;
+    frameTimings.Draw(GLOBALS::defaultFont, TILE_WIDTH_PIXELS_UNSCALED, TILE_HEIGHT_PIXELS_UNSCALED);
 
-        case eACTION_FIRE:
-        	if (GLOBALS::player.CanFireBullet())
-        		GLOBALS::player.FireBullet();
-            break;
-    }
+    al_draw_textf(GLOBALS::defaultFont, al_map_rgb(255,255,255), TILE_WIDTH_PIXELS_UNSCALED, height - TILE_HEIGHT_PIXELS_UNSCALED, 0,
+                  "state(%s) onGround(%d) x(%.2f) y(%.2f) sprites(%u) awake(%u) scale(%d)",
+                  snapshot.playerState, snapshot.onGround, snapshot.player.x, snapshot.player.y,
+                  GLOBALS::sprites.LastBatchSize(), snapshot.awake, GLOBALS::presenter.Scale());
 }
 
 void ShutdownGame(void)
 {
-    al_stop_samples();
+    // in case the game is over before loading was, e.g. audio wouldn't start
+    assetLoader.Finish();
+
+    if (GLOBALS::tileAtlas_unscaled)
+        al_destroy_bitmap(GLOBALS::tileAtlas_unscaled);
+
+    DestroyCollisionMasks();
+    GLOBALS::level.Unload();
+
+    al_shutdown_image_addon();
+
+    // the rest was never set up for a headless run
+    if (GLOBALS::headless)
+        return;
+
+    GLOBALS::sound.Destroy();
+
+    GLOBALS::background.Destroy();
+    GLOBALS::presenter.Destroy();
 
     if (GLOBALS::defaultFont)
         al_destroy_font(GLOBALS::defaultFont);
@@ -589,88 +1174,41 @@ void ShutdownGame(void)
     if (GLOBALS::display)
         al_destroy_display(GLOBALS::display);
 
-    if (GLOBALS::tileAtlas_unscaled)
-        al_destroy_bitmap(GLOBALS::tileAtlas_unscaled);
-
     al_shutdown_ttf_addon();
     al_shutdown_font_addon();
-    al_shutdown_image_addon();
     al_shutdown_primitives_addon();
     al_uninstall_audio();
     al_uninstall_keyboard();
 }
 
-void CreateBackgroundImage(void)
-{
-    const unsigned int atlasWidth_tiles = al_get_bitmap_width(GLOBALS::tileAtlas_unscaled) / TILE_WIDTH_PIXELS_UNSCALED;
-    signed int tileID;
-
-    assert(GLOBALS::background_scaled != NULL);
-
-
-    al_set_target_bitmap(GLOBALS::background_scaled);
-
-    // clear to a reasonable sky blue color so that the background layer of the map is not required to be completely filled in.
-    al_clear_to_color(al_map_rgb(50,50,200));
-
-    for (unsigned int y = 0; y < LEVEL_HEIGHT_TILES; ++y)
-    {
-        for (unsigned int x = 0; x < LEVEL_WIDTH_TILES; ++x)
-        {
-            tileID = level1MapData.backTiles[(y*LEVEL_WIDTH_TILES)+x];
-
-            if (tileID != -1)
-                al_draw_scaled_bitmap(GLOBALS::tileAtlas_unscaled,
-                                      (tileID % atlasWidth_tiles) * TILE_WIDTH_PIXELS_UNSCALED, (tileID / atlasWidth_tiles) * TILE_HEIGHT_PIXELS_UNSCALED,
-                                      TILE_WIDTH_PIXELS_UNSCALED, TILE_HEIGHT_PIXELS_UNSCALED,
-                                      (TILE_WIDTH_PIXELS_UNSCALED * SCALE_FACTOR) * x, (TILE_HEIGHT_PIXELS_UNSCALED * SCALE_FACTOR) * y,
-                                      TILE_WIDTH_PIXELS_UNSCALED * SCALE_FACTOR, TILE_HEIGHT_PIXELS_UNSCALED * SCALE_FACTOR,
-                                      0);
-
-            tileID = level1MapData.midTiles[(y*LEVEL_WIDTH_TILES)+x];
-
-            if (tileID != -1)
-                al_draw_scaled_bitmap(GLOBALS::tileAtlas_unscaled,
-                                      (tileID % atlasWidth_tiles) * TILE_WIDTH_PIXELS_UNSCALED, (tileID / atlasWidth_tiles) * TILE_HEIGHT_PIXELS_UNSCALED,
-                                      TILE_WIDTH_PIXELS_UNSCALED, TILE_HEIGHT_PIXELS_UNSCALED,
-                                      (TILE_WIDTH_PIXELS_UNSCALED * SCALE_FACTOR) * x, (TILE_HEIGHT_PIXELS_UNSCALED * SCALE_FACTOR) * y,
-                                      TILE_WIDTH_PIXELS_UNSCALED * SCALE_FACTOR, TILE_HEIGHT_PIXELS_UNSCALED * SCALE_FACTOR,
-                                      0);
-        }
-    }
-}
-
 bool OnSolidGround(void)
 {
     // can only possibly be on solid ground on a tile boundary
-    if ((GLOBALS::player.m_y % TILE_HEIGHT_PIXELS_UNSCALED) != 0)
+    if (fmod(GLOBALS::player.m_y, TILE_HEIGHT_PIXELS_UNSCALED) != 0.0)
         return false;
 
-    // X coord of the left-most column of the player
-    int tileX = GLOBALS::player.m_x / TILE_WIDTH_PIXELS_UNSCALED;
-
     // X coord of the right-most column of the player
     int playerXright = (GLOBALS::player.m_x + GLOBALS::player.DrawWidth() - 1);
-    int tileXright = playerXright / TILE_WIDTH_PIXELS_UNSCALED;
 
-    // the Y coord of the row immediately below the player
-    int tileY = (GLOBALS::player.m_y + TILE_HEIGHT_PIXELS_UNSCALED) / TILE_HEIGHT_PIXELS_UNSCALED;
-
-    // need to check both left- and right-edged tiles below player in case player is straddling two tiles
-    // (which is the usual case)
-    bool onSolidGround = ((level1MapData.bounds[tileY * LEVEL_WIDTH_TILES + tileX]      & SOLID_TOP) ||
-                          (level1MapData.bounds[tileY * LEVEL_WIDTH_TILES + tileXright] & SOLID_TOP));    
+    // covers both columns below the player when they're straddling two tiles (which is the usual case)
+    bool onSolidGround = (DistanceToGround(GLOBALS::player.m_x, GLOBALS::player.m_y,
+                                           GLOBALS::player.DrawWidth(), TILE_HEIGHT_PIXELS_UNSCALED, 0.0) == 0.0);
 
+    // only the pushables in the row right below the player's feet can be stood upon
+    // (kept between calls so it doesn't have to be reallocated every time)
+    static std::vector<TInteractiveRef> below;
     bool onPushable = false;
     signed int x, y, width;
-    for (std::list<TObject *>::iterator it = GLOBALS::interactives.begin(); (it != GLOBALS::interactives.end()) && !onPushable; ++it)
+
+    below.clear();
+    GLOBALS::interactives.Query(GLOBALS::player.m_x, GLOBALS::player.m_y + TILE_HEIGHT_PIXELS_UNSCALED, GLOBALS::player.DrawWidth(), 1, below);
+    for (std::vector<TInteractiveRef>::iterator it = below.begin(); (it != below.end()) && !onPushable; ++it)
     {
-        assert(*it);
-        if (dynamic_cast<TPushable*>(*it))
+        if (KindOfRef(*it) == eINTERACTIVE_PUSHABLE)
         {
-            x = (*it)->m_x;
-            y = (*it)->m_y;
-            width = (*it)->DrawWidth();
+            x = GLOBALS::interactives.X(*it);
+            y = GLOBALS::interactives.Y(*it);
+            width = GLOBALS::interactives.DrawWidth(*it);
 
             if ((y == (GLOBALS::player.m_y + TILE_HEIGHT_PIXELS_UNSCALED)) && /* player just above a Pushable */
                 ((GLOBALS::player.m_x >= x && GLOBALS::player.m_x < (x + width) ) ||   /* player's left side within Pushable */
@@ -684,153 +1222,45 @@ bool OnSolidGround(void)
     return onSolidGround || onPushable;
 }
 
-bool CanMoveUp(void)
+// the codes that ResetLevel() turns into interactives, which then take the place of the mid-layer tile
+bool SpawnsInteractive(signed short code)
 {
-    // X coord of the left-most column of the player
-    int tileX = GLOBALS::player.m_x / TILE_WIDTH_PIXELS_UNSCALED;
-
-    // X coord of the right-most column of the player
-    int tileXright = (GLOBALS::player.m_x + GLOBALS::player.DrawWidth() - 1) / TILE_WIDTH_PIXELS_UNSCALED;
-
-    // the Y coord of the row immediately above the player
-    int tileY = (GLOBALS::player.m_y - 1) / TILE_HEIGHT_PIXELS_UNSCALED;
-
-    // need to check both left- and right-edged tiles above player in case player is straddling two tiles
-    // (which is the usual case)
-    bool canMoveUp = (!(level1MapData.bounds[tileY * LEVEL_WIDTH_TILES + tileX]      & SOLID_BOTTOM) &&
-                      !(level1MapData.bounds[tileY * LEVEL_WIDTH_TILES + tileXright] & SOLID_BOTTOM));        
-
-    return canMoveUp;
+    return (code == eCODE_GLASSES) || (code == eCODE_PUSHABLE) || (code == eCODE_AMMO) || (code == eCODE_SATELLITE_DISH);
 }
 
-
-// Pixel Perfect collision detector
-// from: https://www.allegro.cc/forums/thread/606547
-bool ObjectCollide(const TObject *object1, const TObject *object2)
+// bring everything drawn from the level up to date with the tiles changed as of snapshot
+void ApplyTileChanges(const TWorldSnapshot &snapshot)
 {
-    assert(object1);
-    assert(object2);
-
-    if (object1 == object2)
-        return true;
-
-    int left1, left2, over_left;
-    int right1, right2, over_right;
-    int top1, top2, over_top;
-    int bottom1, bottom2, over_bottom;
-    int over_width, over_height;
-    int cx, cy;
-    ALLEGRO_COLOR pixel[2];
-    ALLEGRO_COLOR trans = al_map_rgba(255,0,255,0);
-    bool collision = false;
-
-    ALLEGRO_BITMAP *obj1_img = BitmapOfTile(object1->TileID());
-    ALLEGRO_BITMAP *obj2_img = BitmapOfTile(object2->TileID());
-
-    assert(obj1_img);
-    assert(obj2_img);
-
-    left1 = object1->m_x;
-    left2 = object2->m_x;
-    right1 = object1->m_x + al_get_bitmap_width(obj1_img);
-    right2 = object2->m_x + al_get_bitmap_width(obj2_img);
-    top1 = object1->m_y;
-    top2 = object2->m_y;
-    bottom1 = object1->m_y + al_get_bitmap_height(obj1_img);
-    bottom2 = object2->m_y + al_get_bitmap_height(obj2_img);
-
-
-    // First we'll test if the bounding boxes overlap.
-    // If they don't overlap at all, there's no sense in checking further.
-    if((bottom1 < top2) ||
-       (top1 > bottom2) ||
-       (right1 < left2) ||
-       (left1 > right2))
-    {
-        collision = false;
-    }
-    else
-    {
-        // The bounding boxes overlap, so there's a potential collision.
-        // We'll store the location of the actual overlap
-        if(bottom1 > bottom2) over_bottom = bottom2;
-        else over_bottom = bottom1;
-
-        if(top1 < top2) over_top = top2;
-        else over_top = top1;
-
-        if(right1 > right2) over_right = right2;
-        else over_right = right1;
-
-        if(left1 < left2) over_left = left2;
-        else over_left = left1;
-
-        over_height = over_bottom - over_top;
-        over_width = over_right - over_left;
-
-        al_lock_bitmap(obj1_img, al_get_bitmap_format(obj1_img), ALLEGRO_LOCK_READONLY);
-        al_lock_bitmap(obj2_img, al_get_bitmap_format(obj2_img), ALLEGRO_LOCK_READONLY);
-        // Okay, we found where the overlap occured and we'll now only check within that area for any
-        // collisions.
-        for(cy=0; cy < over_height; cy++)
-        {
-            for(cx=0; cx < over_width; cx++)
-            {
-                // sample a pixel from each object
-                pixel[0] = al_get_pixel(obj1_img, (over_left-object1->m_x)+cx, (over_top-object1->m_y)+cy);
-                pixel[1] = al_get_pixel(obj2_img, (over_left-object2->m_x)+cx, (over_top-object2->m_y)+cy);
-
-                if((memcmp(&pixel[0], &trans, sizeof(trans)) != 0) &&
-                   (memcmp(&pixel[1], &trans, sizeof(trans)) != 0))
-                {
-                    collision=true;
-                    break;
-                }
-            }
-        
-        if(collision)
-            break;
-        }
-
-        al_unlock_bitmap(obj1_img);
-        al_unlock_bitmap(obj2_img);
-    }
-
-    al_destroy_bitmap(obj1_img);
-    al_destroy_bitmap(obj2_img);
-
-    return collision;
+    for (std::vector<TTileRect>::const_iterator it = snapshot.dirty.begin(); it != snapshot.dirty.end(); ++it)
+        GLOBALS::background.Redraw(snapshot, *it);
 }
 
 void ResetLevel(void)
 {
-    unsigned int i;
+    const std::vector<TSpawn> &spawns = GLOBALS::level.Spawns();
     signed int x, y;
 
-    GLOBALS::interactives.clear();
+    // undo whatever happened to the level last time round (the background catches up with the next snapshot)
+    GLOBALS::level.Revert();
+
+    GLOBALS::interactives.Reset(GLOBALS::level.WidthPixels(), GLOBALS::level.HeightPixels());
 
-    /* starting tile position is mapcode 1 */
-    for (i = 0; i < (LEVEL_HEIGHT_TILES * LEVEL_WIDTH_TILES); ++i)
+    // everything the codes layer puts in the level, as found when it was loaded
+    for (std::vector<TSpawn>::const_iterator it = spawns.begin(); it != spawns.end(); ++it)
     {
-        x = (i % LEVEL_WIDTH_TILES) * TILE_WIDTH_PIXELS_UNSCALED;
-        y = (i / LEVEL_WIDTH_TILES) * TILE_HEIGHT_PIXELS_UNSCALED;
+        x = it->tileX * TILE_WIDTH_PIXELS_UNSCALED;
+        y = it->tileY * TILE_HEIGHT_PIXELS_UNSCALED;
 
-        switch(level1MapData.codes[i])
+        switch(it->code)
         {
             case eCODE_PLAYER_SPAWN:
-                GLOBALS::player.m_x = x;
-                GLOBALS::player.m_y = y;
-                printf("\nDBUG: spawned player at (%d, %d)", x, y);
-                break;
-
-            case eCODE_INVISIBLE_PLATFORM:
-                // nothing - handled when glasses are picked up
+                GLOBALS::player.Reset(x, y);
+                TRACE_INFO("spawned player", "x", x, "y", y);
                 break;
 
             case eCODE_GLASSES:
-                level1MapData.midTiles[i] = -1;
-                GLOBALS::interactives.push_back(new TGlasses(x,y));
-                printf("\nDBUG: created glasses at (%d, %d)", x, y);
+                GLOBALS::interactives.Spawn(eINTERACTIVE_GLASSES, TGlasses::TILE_ID, x, y);
+                TRACE_INFO("created glasses", "x", x, "y", y);
                 break;
 
             case eCODE_TNT:
@@ -839,97 +1269,53 @@ void ResetLevel(void)
 
             case eCODE_PUSHABLE:
                 // create new pushable interactive with the tile ID of what's in the mid-layer of this square
-                GLOBALS::interactives.push_back(new TPushable(level1MapData.midTiles[i], x, y));
-                level1MapData.midTiles[i] = -1;
-                printf("\nDBUG: created pushable at (%d, %d)", x, y);
+                GLOBALS::interactives.Spawn(eINTERACTIVE_PUSHABLE, it->midTileID, x, y);
+                TRACE_INFO("created pushable", "x", x, "y", y);
                 break;
 
             case eCODE_AMMO:
-                level1MapData.midTiles[i] = -1;
-                GLOBALS::interactives.push_back(new TAmmo(x,y));
-                printf("\nDBUG: created ammo at (%d, %d)", x, y);
+                GLOBALS::interactives.Spawn(eINTERACTIVE_AMMO, TAmmo::TILE_ID, x, y);
+                TRACE_INFO("created ammo", "x", x, "y", y);
                 break;
 
             case eCODE_SATELLITE_DISH:
-                level1MapData.midTiles[i] = -1;
-                GLOBALS::interactives.push_back(new TSatelliteDish(x,y));
-                printf("\nDBUG: created satellite dish at (%d, %d)", x, y);
+                GLOBALS::interactives.Spawn(eINTERACTIVE_SATELLITE_DISH, TSatelliteDish::frames[0], x, y, TSatelliteDish::Width(0));
+                TRACE_INFO("created satellite dish", "x", x, "y", y);
                 break;
         }
     }
 
-    // unscaled pixels per step
-    GLOBALS::player.m_xVelocity = 2;
-    GLOBALS::player.m_yVelocity = 2;
-
-    GLOBALS::player.m_jumping = false;
-    GLOBALS::player.m_jumpedSoFar = 0;
-    GLOBALS::player.m_facing = eFACING_RIGHT;
-
-    CreateBackgroundImage();
-
-    RedrawScreen();
+    // back to the chunks around wherever the player now is
+    GLOBALS::level.Stream(GLOBALS::player.m_x, GLOBALS::player.m_y);
 }
 
 bool InDeathSquare(void)
 {
-    unsigned int tileX, tileY, tileIndex;
-
-    // upper-left corner of player
-    tileY = GLOBALS::player.m_y / TILE_HEIGHT_PIXELS_UNSCALED;
-    tileX = GLOBALS::player.m_x / TILE_WIDTH_PIXELS_UNSCALED;
-    tileIndex = (tileY * LEVEL_WIDTH_TILES) + tileX;
-    if (level1MapData.codes[tileIndex] == eCODE_DEATH)
-        return true;
-
-    // upper-right corner of player
-    tileX = (GLOBALS::player.m_x + GLOBALS::player.DrawWidth() - 1) / TILE_WIDTH_PIXELS_UNSCALED;
-    tileIndex = (tileY * LEVEL_WIDTH_TILES) + tileX;
-    if (level1MapData.codes[tileIndex] == eCODE_DEATH)
-        return true;
-
-    // lower-left corner of player
-    tileY = (GLOBALS::player.m_y + TILE_HEIGHT_PIXELS_UNSCALED - 1) / TILE_HEIGHT_PIXELS_UNSCALED;
-    tileX = GLOBALS::player.m_x / TILE_WIDTH_PIXELS_UNSCALED;
-    tileIndex = (tileY * LEVEL_WIDTH_TILES) + tileX;
-    if (level1MapData.codes[tileIndex] == eCODE_DEATH)
-        return true;
-
-    // lower-right corner of player
-    tileX = (GLOBALS::player.m_x + GLOBALS::player.DrawWidth() - 1) / TILE_WIDTH_PIXELS_UNSCALED;
-    tileIndex = (tileY * LEVEL_WIDTH_TILES) + tileX;
-    if (level1MapData.codes[tileIndex] == eCODE_DEATH)
-        return true;
-
-    return false;
-}
-
-ALLEGRO_BITMAP *BitmapOfTile(unsigned int tileID)
-{
-    unsigned int atlasWidth_tiles = al_get_bitmap_width(GLOBALS::tileAtlas_unscaled) / TILE_WIDTH_PIXELS_UNSCALED;
-
-    ALLEGRO_BITMAP *bmp = al_create_sub_bitmap(GLOBALS::tileAtlas_unscaled,
-                                               (tileID % atlasWidth_tiles) * TILE_WIDTH_PIXELS_UNSCALED, (tileID / atlasWidth_tiles) * TILE_HEIGHT_PIXELS_UNSCALED,
-                                               TILE_WIDTH_PIXELS_UNSCALED, TILE_HEIGHT_PIXELS_UNSCALED);
-
-    assert(bmp);
-
-    return bmp;
+    // columns and rows of the player's corners
+    const signed int tileX      = GLOBALS::player.m_x / TILE_WIDTH_PIXELS_UNSCALED;
+    const signed int tileXright = (GLOBALS::player.m_x + GLOBALS::player.DrawWidth() - 1) / TILE_WIDTH_PIXELS_UNSCALED;
+    const signed int tileY      = GLOBALS::player.m_y / TILE_HEIGHT_PIXELS_UNSCALED;
+    const signed int tileYlower = (GLOBALS::player.m_y + TILE_HEIGHT_PIXELS_UNSCALED - 1) / TILE_HEIGHT_PIXELS_UNSCALED;
+
+    return (GLOBALS::level.Tile(eLAYER_CODES, tileX,      tileY)      == eCODE_DEATH) || // upper-left
+           (GLOBALS::level.Tile(eLAYER_CODES, tileXright, tileY)      == eCODE_DEATH) || // upper-right
+           (GLOBALS::level.Tile(eLAYER_CODES, tileX,      tileYlower) == eCODE_DEATH) || // lower-left
+           (GLOBALS::level.Tile(eLAYER_CODES, tileXright, tileYlower) == eCODE_DEATH);   // lower-right
 }
 
-void DrawStatusBar(void)
+void DrawStatusBar(const TWorldSnapshot &snapshot)
 {
-    al_draw_filled_rectangle(SCREEN_WIDTH_PIXELS_SCALED, 0, SCREEN_WIDTH_PIXELS_SCALED + (TILE_HEIGHT_PIXELS_UNSCALED * 3 * SCALE_FACTOR), SCREEN_HEIGHT_PIXELS_SCALED, al_map_rgb(10,10,150));
+    al_draw_filled_rectangle(VIEWPORT_WIDTH_PIXELS_UNSCALED, 0, FRAME_WIDTH_PIXELS_UNSCALED, FRAME_HEIGHT_PIXELS_UNSCALED, al_map_rgb(10,10,150));
 
-    al_draw_textf(GLOBALS::defaultFont, al_map_rgb(255,255,255), SCREEN_WIDTH_PIXELS_SCALED + (TILE_WIDTH_PIXELS_UNSCALED * SCALE_FACTOR), TILE_HEIGHT_PIXELS_UNSCALED    , 0,
+    al_draw_textf(GLOBALS::defaultFont, al_map_rgb(255,255,255), VIEWPORT_WIDTH_PIXELS_UNSCALED + (TILE_WIDTH_PIXELS_UNSCALED / 4), (TILE_HEIGHT_PIXELS_UNSCALED / 2) * 1, 0,
                   "Score: %d",
-                  GLOBALS::player.Score());
+                  snapshot.score);
 
-    al_draw_textf(GLOBALS::defaultFont, al_map_rgb(255,255,255), SCREEN_WIDTH_PIXELS_SCALED + (TILE_WIDTH_PIXELS_UNSCALED * SCALE_FACTOR), TILE_HEIGHT_PIXELS_UNSCALED * 2, 0,
+    al_draw_textf(GLOBALS::defaultFont, al_map_rgb(255,255,255), VIEWPORT_WIDTH_PIXELS_UNSCALED + (TILE_WIDTH_PIXELS_UNSCALED / 4), (TILE_HEIGHT_PIXELS_UNSCALED / 2) * 2, 0,
                   "Shots: %d",
-                  GLOBALS::player.Ammo());
+                  snapshot.ammo);
 
-    al_draw_textf(GLOBALS::defaultFont, al_map_rgb(255,255,255), SCREEN_WIDTH_PIXELS_SCALED + (TILE_WIDTH_PIXELS_UNSCALED * SCALE_FACTOR), TILE_HEIGHT_PIXELS_UNSCALED * 3, 0,
+    al_draw_textf(GLOBALS::defaultFont, al_map_rgb(255,255,255), VIEWPORT_WIDTH_PIXELS_UNSCALED + (TILE_WIDTH_PIXELS_UNSCALED / 4), (TILE_HEIGHT_PIXELS_UNSCALED / 2) * 3, 0,
                   "Lives: %d",
                   0);
 
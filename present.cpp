@@ -0,0 +1,98 @@
+#include <cassert>
+#include <cstdio>
+
+#include <allegro5/allegro.h>
+
+#include "sam_shared.hpp"
+#include "present.hpp"
+#include "trace.hpp"
+
+namespace GLOBALS
+{
+    TPresenter presenter;
+}
+
+TPresenter::TPresenter() :
+        m_display(NULL),
+        m_frame(NULL),
+        m_requestedScale(0),
+        m_scale(1),
+        m_x(0),
+        m_y(0)
+{
+}
+
+TPresenter::~TPresenter()
+{
+    Destroy();
+}
+
+bool TPresenter::Create(ALLEGRO_DISPLAY *display, signed int requestedScale)
+{
+    assert(display);
+
+    Destroy();
+
+    m_frame = al_create_bitmap(FRAME_WIDTH_PIXELS_UNSCALED, FRAME_HEIGHT_PIXELS_UNSCALED);
+    if (m_frame == NULL)
+    {
+        fprintf(stderr, "\nERROR: unable to create frame bitmap");
+        return false;
+    }
+
+    m_display = display;
+    m_requestedScale = requestedScale;
+    Resize();
+
+    return true;
+}
+
+void TPresenter::Destroy()
+{
+    if (m_frame)
+        al_destroy_bitmap(m_frame);
+
+    m_frame = NULL;
+    m_display = NULL;
+}
+
+void TPresenter::Resize()
+{
+    assert(m_display);
+
+    const signed int displayWidth  = al_get_display_width(m_display);
+    const signed int displayHeight = al_get_display_height(m_display);
+
+    m_scale = min(displayWidth / FRAME_WIDTH_PIXELS_UNSCALED, displayHeight / FRAME_HEIGHT_PIXELS_UNSCALED);
+
+    if ((m_requestedScale > 0) && (m_requestedScale < m_scale))
+        m_scale = m_requestedScale;
+    else if ((m_requestedScale > m_scale) || (m_scale < 1))
+    {
+        // a display smaller than the frame still gets all of it, just not with every pixel showing
+        fprintf(stderr, "\nWARNING: the display (%dx%d) is too small for %dx scaling",
+                        displayWidth, displayHeight, max(m_requestedScale, 1));
+        m_scale = max(m_scale, 1);
+    }
+
+    m_x = (displayWidth  - (FRAME_WIDTH_PIXELS_UNSCALED  * m_scale)) / 2;
+    m_y = (displayHeight - (FRAME_HEIGHT_PIXELS_UNSCALED * m_scale)) / 2;
+
+    TRACE_INFO("presenting frame", "scale", m_scale, "display width", displayWidth);
+}
+
+void TPresenter::Present()
+{
+    assert(m_frame);
+
+    al_set_target_backbuffer(m_display);
+
+    // the letterboxing. After a flip the backbuffer's contents are undefined, so this can't be done just once
+    al_clear_to_color(al_map_rgb(0, 0, 0));
+
+    // no ALLEGRO_MAG_LINEAR on the frame, so whole-number scaling keeps every pixel a crisp square
+    al_draw_scaled_bitmap(m_frame,
+                          0, 0, FRAME_WIDTH_PIXELS_UNSCALED, FRAME_HEIGHT_PIXELS_UNSCALED,
+                          m_x, m_y, FRAME_WIDTH_PIXELS_UNSCALED * m_scale, FRAME_HEIGHT_PIXELS_UNSCALED * m_scale,
+                          0);
+}
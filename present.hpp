@@ -0,0 +1,45 @@
+#ifndef _PRESENT_HPP_
+#define _PRESENT_HPP_
+
+#include <allegro5/allegro.h>
+
+// Everything the game shows is drawn unscaled into a single FRAME_WIDTH x FRAME_HEIGHT bitmap, and
+// Present() then puts that on the display in one scaled draw. The scale is the largest whole number
+// that fits the display (or whatever was asked for, if that fits), so pixels stay square and sharp,
+// and the frame is centred with black bars around whatever it doesn't fill.
+class TPresenter
+{
+public:
+    TPresenter();
+    ~TPresenter();
+
+    // Makes the frame bitmap with the current new bitmap flags. requestedScale 0 means as large as fits.
+    bool Create(ALLEGRO_DISPLAY *display, signed int requestedScale);
+    void Destroy();
+
+    // where the scaled frame goes, worked out again from the display's current size
+    void Resize();
+
+    // what to draw a frame into
+    ALLEGRO_BITMAP *Frame() const { return m_frame; };
+
+    // Scales the frame onto the display's backbuffer, which is left as the target bitmap so that
+    // anything drawn afterwards (e.g. debugging overlays) is drawn at the display's full resolution.
+    void Present();
+
+    signed int Scale() const { return m_scale; };
+
+private:
+    ALLEGRO_DISPLAY *m_display;
+    ALLEGRO_BITMAP *m_frame;
+    signed int m_requestedScale;
+    signed int m_scale;
+    signed int m_x, m_y; // top left of the scaled frame on the display
+};
+
+namespace GLOBALS
+{
+    extern TPresenter presenter;
+}
+
+#endif
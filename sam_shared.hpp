@@ -1,7 +1,6 @@
 #ifndef _SAM_SHARED_HPP_
 #define _SAM_SHARED_HPP_
 
-#include <list>
 #include <allegro5/allegro.h>
 #include <allegro5/allegro_image.h>
 #include <allegro5/allegro_font.h>
@@ -9,39 +8,43 @@
 extern const char *ORGANIZATION_NAME;
 extern const char *APPLICATION_NAME;
 
-extern const signed int TILE_WIDTH_PIXELS_UNSCALED;
-extern const signed int TILE_HEIGHT_PIXELS_UNSCALED;
+// constexpr rather than extern, so that anything sized from them can be worked out at compile time
+constexpr signed int TILE_WIDTH_PIXELS_UNSCALED  = 32;
+constexpr signed int TILE_HEIGHT_PIXELS_UNSCALED = 32;
 
-extern const signed int VIEWPORT_WIDTH_TILES;
-extern const signed int VIEWPORT_HEIGHT_TILES;
+constexpr signed int VIEWPORT_WIDTH_TILES  = 20;
+constexpr signed int VIEWPORT_HEIGHT_TILES = 15;
 
-extern const signed int VIEWPORT_WIDTH_PIXELS_UNSCALED;
-extern const signed int VIEWPORT_HEIGHT_PIXELS_UNSCALED;
-
-extern const signed int LEVEL_WIDTH_VIEWPORTS;
-extern const signed int LEVEL_HEIGHT_VIEWPORTS;
-
-extern const signed int LEVEL_WIDTH_TILES;
-extern const signed int LEVEL_HEIGHT_TILES;
+constexpr signed int VIEWPORT_WIDTH_PIXELS_UNSCALED  = VIEWPORT_WIDTH_TILES  * TILE_WIDTH_PIXELS_UNSCALED;
+constexpr signed int VIEWPORT_HEIGHT_PIXELS_UNSCALED = VIEWPORT_HEIGHT_TILES * TILE_HEIGHT_PIXELS_UNSCALED;
 
 extern const signed int PLAYER_MAX_JUMP_HEIGHT_UNSCALED;
 
-extern const signed int SCALE_FACTOR;
-
-extern const signed int LEVEL_WIDTH_PIXELS_UNSCALED;
-extern const signed int LEVEL_HEIGHT_PIXELS_UNSCALED;
+// the status bar sits to the right of the viewport, and the two together are the frame the game draws
+extern const signed int STATUS_BAR_WIDTH_PIXELS_UNSCALED;
 
-extern const signed int SCREEN_WIDTH_PIXELS_SCALED;
-extern const signed int SCREEN_HEIGHT_PIXELS_SCALED;
+extern const signed int FRAME_WIDTH_PIXELS_UNSCALED;
+extern const signed int FRAME_HEIGHT_PIXELS_UNSCALED;
 
 // how many seconds is each frame of the player's animation displayed for
 extern const double ANIMATION_RATE;
 
+// the game world always advances in steps of exactly this length, however fast the display is
+extern const signed int SIMULATION_TICKS_PER_SECOND;
+extern const double SIMULATION_TICK_SECONDS;
+
+// the most real time a single frame is allowed to account for
+extern const double MAX_FRAME_SECONDS;
+
+// how much game time a headless run simulates when not told otherwise
+extern const double DEFAULT_HEADLESS_SECONDS;
+
 // forward declarations of interactives
 class TObject;
 class TMobile;
 class TPlayer;
-class TGlasses;
+class TInteractives;
+class TWorldSnapshot;
 
 // from: http://stackoverflow.com/questions/3437404/min-and-max-in-c
 // Note: __typeof__ operator may be GCC specific
@@ -94,8 +97,34 @@ typedef enum
     eACTION_MOVE_RIGHT  = 1,
     eACTION_JUMP        = 2,
     eACTION_FIRE        = 3,
+
+    eACTION_COUNT // ALWAYS LAST - is the number of actions in the enum
 } action_t;
 
+/* everything the player wants to do during one tick, one bit per action_t */
+typedef unsigned char TActionSet;
+#define ACTION_BIT(action) (1 << (action))
+
+/* the kinds of interactive a level can contain. Each kind is stored in a pool of its own. */
+typedef enum
+{
+    eINTERACTIVE_GLASSES        = 0,
+    eINTERACTIVE_AMMO           = 1,
+    eINTERACTIVE_PUSHABLE       = 2,
+    eINTERACTIVE_SATELLITE_DISH = 3,
+    eINTERACTIVE_BULLET         = 4, // keep last, TInteractives::Activate() counts on bullets sorting to the end
+
+    eINTERACTIVE_KIND_COUNT // ALWAYS LAST - is the number of kinds in the enum
+} TInteractiveKind;
+
+/* names a single interactive: its kind in the top byte, its index within that kind's pool in the rest.
+   Only valid until the next interactive of the same kind is destroyed. */
+typedef unsigned int TInteractiveRef;
+
+inline TInteractiveRef MakeInteractiveRef(TInteractiveKind kind, unsigned int index) { return (TInteractiveRef(kind) << 24) | index; }
+inline TInteractiveKind KindOfRef(TInteractiveRef ref) { return TInteractiveKind(ref >> 24); }
+inline unsigned int IndexOfRef(TInteractiveRef ref) { return ref & 0x00FFFFFF; }
+
 
 namespace GLOBALS
 {
@@ -104,23 +133,40 @@ namespace GLOBALS
     extern ALLEGRO_BITMAP *tileAtlas_unscaled;
     extern ALLEGRO_FONT *defaultFont;
 
-    extern ALLEGRO_BITMAP *background_scaled;
+    // no display, keyboard or audio; just the simulation. Set from the command line.
+    extern bool headless;
 
     extern TPlayer player;
-    extern std::list<TObject *> interactives;
+    extern TInteractives interactives;
 }
 
 
-void RedrawScreen(void);
-void CreateBackgroundImage(void);
+// Headless runs (and the benchmarks) are fully loaded on return. Otherwise loading carries on in the
+// background, and is finished by the title screen.
+bool InitGame(int argc, char **argv);
+void ShutdownGame(void);
+void ResetLevel(void);
+
+// whether the tile with this code in the codes layer is drawn by an interactive rather than the background
+bool SpawnsInteractive(signed short code);
+
+// Copies what the display needs out of the world as it is now. time is the real time (al_get_time())
+// the latest tick was due at. Only from the thread running the simulation.
+void FillSnapshot(TWorldSnapshot &snapshot, double time);
+
+// interpolation: 0.0 draws the snapshot's world as of the tick before its latest, 1.0 as of the latest one
+void RedrawScreen(const TWorldSnapshot &snapshot, double interpolation);
+
+// The viewport and status bar, unscaled, into whatever the current target bitmap is (FRAME_WIDTH x
+// FRAME_HEIGHT pixels of it). RedrawScreen() is this into the presenter's frame, then presenting and flipping.
+void DrawFrame(const TWorldSnapshot &snapshot, double interpolation);
 
 bool OnSolidGround(void);
-bool CanMoveVerticalBy(double pixels);
 bool InDeathSquare(void);
 
-bool ObjectCollide(const TObject *object1, const TObject *object2);
-
-ALLEGRO_BITMAP *BitmapOfTile(unsigned int tileID);
+// pixel-perfect test of two tiles drawn at the given positions (unscaled pixels)
+bool ObjectCollide(unsigned int tileID1, signed int x1, signed int y1,
+                   unsigned int tileID2, signed int x2, signed int y2);
 
 
 #endif
@@ -0,0 +1,61 @@
+#include <vector>
+#include <unordered_map>
+
+#include "sam_shared.hpp"
+#include "snapshot.hpp"
+
+TWorldSnapshot::TWorldSnapshot() :
+        time(0.0),
+        levelWidthTiles(0),
+        levelHeightTiles(0),
+        windowVersion(0),
+        score(0),
+        ammo(0),
+        inputsTaken(0),
+        playerState(""),
+        onGround(false),
+        awake(0)
+{
+    const TSpriteSnapshot nowhere = { 0, 0.0, 0.0, 0.0, 0.0 };
+    const TTileRect empty = { 0, 0, -1, -1 };
+
+    player = nowhere;
+    window = empty;
+
+    for (unsigned int i = 0; i < ePHASE_COUNT; ++i)
+        phaseSeconds[i] = 0.0;
+}
+
+bool TWorldSnapshot::InWindow(const TTileRect &rect) const
+{
+    return (rect.left >= window.left) && (rect.right <= window.right) && (rect.top >= window.top) && (rect.bottom <= window.bottom);
+}
+
+TSnapshotBuffers::TSnapshotBuffers() :
+        m_back(0),
+        m_front(1),
+        m_middle(2)
+{
+}
+
+bool TSnapshotBuffers::Publish()
+{
+    // release, so the reader sees everything written to the snapshot, and acquire, so the reader is
+    // done with the one handed back before it's written to
+    const unsigned int old = m_middle.exchange(m_back | FRESH, std::memory_order_acq_rel);
+
+    m_back = old & INDEX;
+
+    return (old & FRESH) != 0;
+}
+
+const TWorldSnapshot *TSnapshotBuffers::Take()
+{
+    // only the writer sets FRESH, so once it's seen here it stays set until the exchange below
+    if ((m_middle.load(std::memory_order_relaxed) & FRESH) == 0)
+        return NULL;
+
+    m_front = m_middle.exchange(m_front, std::memory_order_acq_rel) & INDEX;
+
+    return &m_buffers[m_front];
+}
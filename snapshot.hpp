@@ -0,0 +1,115 @@
+#ifndef _SNAPSHOT_HPP_
+#define _SNAPSHOT_HPP_
+
+#include <atomic>
+#include <vector>
+
+#include "sam_shared.hpp"
+#include "level.hpp"
+#include "frame_timing.hpp"
+
+// where something was drawn as of the last two ticks
+typedef struct
+{
+    unsigned int tileID;
+    double x, y;                 // unscaled pixels, as of the latest tick
+    double previousX, previousY; // and the one before it
+
+    // alpha: 0.0 is the previous position, 1.0 the latest one
+    double InterpolatedX(double alpha) const { return previousX + ((x - previousX) * alpha); };
+    double InterpolatedY(double alpha) const { return previousY + ((y - previousY) * alpha); };
+} TSpriteSnapshot;
+
+// Everything the display needs to draw a frame, copied out of the simulation at the end of a tick, so
+// that drawing never has to look at the live world while the next tick is changing it.
+class TWorldSnapshot
+{
+public:
+    TWorldSnapshot();
+
+    // the level's back tile, and the mid tile unless an interactive draws itself there instead.
+    // -1 (nothing) outside the window.
+    signed short BackTile(signed int tileX, signed int tileY) const;
+    signed short MidTile(signed int tileX, signed int tileY) const;
+
+    // whether every tile of rect was copied
+    bool InWindow(const TTileRect &rect) const;
+
+    double time; // the real time (al_get_time()) the latest tick was due at
+
+    signed int levelWidthTiles, levelHeightTiles;
+
+    TSpriteSnapshot player;
+    std::vector<TSpriteSnapshot> sprites; // the interactives around the camera, in drawing order
+
+    // The tiles around the camera, row by row. Only recopied when they could have changed, which is
+    // whenever window or windowVersion don't match what the simulation has.
+    TTileRect window;
+    unsigned int windowVersion;
+    std::vector<signed short> backTiles, midTiles;
+
+    // every rect of tiles changed that the display may not have seen yet
+    std::vector<TTileRect> dirty;
+
+    unsigned int score, ammo;
+
+    // how many input changes the simulation had acted on as of the latest tick
+    unsigned int inputsTaken;
+
+    // for the debug overlay
+    const char *playerState;
+    bool onGround;
+    unsigned int awake;
+
+    // how long the simulation's phases took in the latest tick, if the overlay is timing them
+    double phaseSeconds[ePHASE_COUNT];
+};
+
+// Passes snapshots from one thread that writes them to one thread that draws them, without either
+// ever waiting on the other. Of the three snapshots, the writer fills in the back one while the reader
+// draws the front one, and the middle one is always the latest finished, which the two swap theirs for.
+class TSnapshotBuffers
+{
+public:
+    TSnapshotBuffers();
+
+    // the snapshot for the writer to fill in
+    TWorldSnapshot &Back() { return m_buffers[m_back]; };
+
+    // Makes the back snapshot the latest. Returns true if the one given back in its place was never
+    // taken by the reader, in which case whatever it was carrying (e.g. dirty rects) still needs passing on.
+    bool Publish();
+
+    // The latest snapshot if there's been one since the last call, otherwise NULL. Only the reader.
+    const TWorldSnapshot *Take();
+
+private:
+    enum
+    {
+        INDEX = 0x3,
+        FRESH = 0x4 // set in m_middle until the reader takes it
+    };
+
+    TWorldSnapshot m_buffers[3];
+    unsigned int m_back;  // only touched by the writer
+    unsigned int m_front; // only touched by the reader
+    std::atomic<unsigned int> m_middle;
+};
+
+inline signed short TWorldSnapshot::BackTile(signed int tileX, signed int tileY) const
+{
+    if ((tileX < window.left) || (tileX > window.right) || (tileY < window.top) || (tileY > window.bottom))
+        return -1;
+
+    return backTiles[((tileY - window.top) * (window.right - window.left + 1)) + (tileX - window.left)];
+}
+
+inline signed short TWorldSnapshot::MidTile(signed int tileX, signed int tileY) const
+{
+    if ((tileX < window.left) || (tileX > window.right) || (tileY < window.top) || (tileY > window.bottom))
+        return -1;
+
+    return midTiles[((tileY - window.top) * (window.right - window.left + 1)) + (tileX - window.left)];
+}
+
+#endif
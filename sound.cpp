@@ -0,0 +1,251 @@
+#include <cassert>
+#include <cstdio>
+
+#include <allegro5/allegro.h>
+#include <allegro5/allegro_audio.h>
+
+#include <physfs.h>
+
+#include "sam_shared.hpp"
+#include "sound.hpp"
+#include "trace.hpp"
+
+namespace GLOBALS
+{
+    TSoundSystem sound;
+}
+
+typedef struct
+{
+    const char *filename;
+    signed int priority; // higher interrupts lower
+    float gain;
+} TEffect;
+
+static const TEffect EFFECTS[eSOUND_COUNT] =
+{
+    { "ammo.wav",  1, 1.0f }, // eSOUND_AMMO_PICKUP
+    { "fire.wav",  0, 0.7f }, // eSOUND_FIRE - the most frequent, so the first to make way
+    { "dish.wav",  1, 1.0f }, // eSOUND_DISH_HIT
+    { "death.wav", 2, 1.0f }, // eSOUND_DEATH
+};
+
+enum
+{
+    MIXER_FREQUENCY = 44100
+};
+
+TSoundSystem::TSoundSystem() :
+        m_null(true),
+        m_voice(NULL),
+        m_mixer(NULL),
+        m_playClock(0),
+        m_music(NULL),
+        m_queueHead(0),
+        m_queueTail(0),
+        m_dropped(0)
+{
+    for (unsigned int i = 0; i < eSOUND_COUNT; ++i)
+        m_samples[i] = NULL;
+
+    for (unsigned int i = 0; i < VOICES; ++i)
+    {
+        m_voices[i].instance = NULL;
+        m_voices[i].priority = 0;
+        m_voices[i].started = 0;
+    }
+}
+
+TSoundSystem::~TSoundSystem()
+{
+    Destroy();
+}
+
+bool TSoundSystem::Create()
+{
+    Destroy();
+
+    m_voice = al_create_voice(MIXER_FREQUENCY, ALLEGRO_AUDIO_DEPTH_INT16, ALLEGRO_CHANNEL_CONF_2);
+    m_mixer = al_create_mixer(MIXER_FREQUENCY, ALLEGRO_AUDIO_DEPTH_FLOAT32, ALLEGRO_CHANNEL_CONF_2);
+
+    if ((m_voice == NULL) || (m_mixer == NULL) || !al_attach_mixer_to_voice(m_mixer, m_voice))
+    {
+        fprintf(stderr, "\nERROR: unable to set up the audio mixer");
+        Destroy();
+        return false;
+    }
+
+    // every voice is ready to go, so playing a sound never has to make anything
+    for (unsigned int i = 0; i < VOICES; ++i)
+    {
+        m_voices[i].instance = al_create_sample_instance(NULL);
+        if ((m_voices[i].instance == NULL) || !al_attach_sample_instance_to_mixer(m_voices[i].instance, m_mixer))
+        {
+            fprintf(stderr, "\nERROR: unable to create sound voices");
+            Destroy();
+            return false;
+        }
+    }
+
+    for (unsigned int i = 0; i < eSOUND_COUNT; ++i)
+    {
+        if (PHYSFS_exists(EFFECTS[i].filename))
+            m_samples[i] = al_load_sample(EFFECTS[i].filename);
+
+        if (m_samples[i] == NULL)
+            fprintf(stderr, "\nWARNING: unable to load sound '%s'", EFFECTS[i].filename);
+    }
+
+    m_null = false;
+
+    return true;
+}
+
+void TSoundSystem::CreateNull()
+{
+    Destroy();
+
+    TRACE_INFO("null sound driver", NULL, 0, NULL, 0);
+}
+
+void TSoundSystem::Destroy()
+{
+    StopMusic();
+
+    for (unsigned int i = 0; i < VOICES; ++i)
+    {
+        if (m_voices[i].instance)
+            al_destroy_sample_instance(m_voices[i].instance);
+        m_voices[i].instance = NULL;
+    }
+
+    // only once nothing is playing them
+    for (unsigned int i = 0; i < eSOUND_COUNT; ++i)
+    {
+        if (m_samples[i])
+            al_destroy_sample(m_samples[i]);
+        m_samples[i] = NULL;
+    }
+
+    if (m_mixer)
+        al_destroy_mixer(m_mixer);
+    if (m_voice)
+        al_destroy_voice(m_voice);
+
+    m_mixer = NULL;
+    m_voice = NULL;
+    m_null = true;
+
+    m_queueHead = m_queueTail = 0;
+}
+
+void TSoundSystem::Post(TSound sound)
+{
+    assert(sound < eSOUND_COUNT);
+
+    const unsigned int tail = m_queueTail.load(std::memory_order_relaxed);
+
+    if (tail - m_queueHead.load(std::memory_order_acquire) >= QUEUE_SLOTS)
+    {
+        ++m_dropped;
+        return;
+    }
+
+    m_queue[tail & (QUEUE_SLOTS - 1)] = sound;
+    m_queueTail.store(tail + 1, std::memory_order_release);
+}
+
+void TSoundSystem::Update()
+{
+    const unsigned int tail = m_queueTail.load(std::memory_order_acquire);
+    unsigned int head = m_queueHead.load(std::memory_order_relaxed);
+
+    for (; head != tail; ++head)
+    {
+        if (!m_null)
+            Play(m_queue[head & (QUEUE_SLOTS - 1)]);
+    }
+
+    m_queueHead.store(head, std::memory_order_release);
+}
+
+void TSoundSystem::Play(TSound sound)
+{
+    const TEffect &effect = EFFECTS[sound];
+    TVoice *voice;
+
+    // didn't load
+    if (m_samples[sound] == NULL)
+        return;
+
+    voice = VoiceFor(effect.priority);
+    if (voice == NULL)
+    {
+        ++m_dropped;
+        return;
+    }
+
+    // stops whatever the voice was playing
+    al_set_sample(voice->instance, m_samples[sound]);
+    al_set_sample_instance_gain(voice->instance, effect.gain);
+    al_play_sample_instance(voice->instance);
+
+    voice->priority = effect.priority;
+    voice->started = ++m_playClock;
+}
+
+TSoundSystem::TVoice *TSoundSystem::VoiceFor(signed int priority)
+{
+    TVoice *lowest = NULL;
+
+    for (unsigned int i = 0; i < VOICES; ++i)
+    {
+        TVoice &voice = m_voices[i];
+
+        if (!al_get_sample_instance_playing(voice.instance))
+            return &voice;
+
+        if ((lowest == NULL) || (voice.priority < lowest->priority) ||
+            ((voice.priority == lowest->priority) && (voice.started < lowest->started)))
+            lowest = &voice;
+    }
+
+    // every voice is busy, so take over the least important of them, if it's no more important than this
+    if (lowest->priority <= priority)
+        return lowest;
+
+    return NULL;
+}
+
+bool TSoundSystem::PlayMusic(const char *filename)
+{
+    StopMusic();
+
+    if (m_null)
+        return true;
+
+    if (!PHYSFS_exists(filename) ||
+        ((m_music = al_load_audio_stream(filename, MUSIC_BUFFERS, MUSIC_BUFFER_SAMPLES)) == NULL))
+    {
+        fprintf(stderr, "\nWARNING: unable to stream music '%s'", filename);
+        return false;
+    }
+
+    al_set_audio_stream_playmode(m_music, ALLEGRO_PLAYMODE_LOOP);
+    if (!al_attach_audio_stream_to_mixer(m_music, m_mixer))
+    {
+        fprintf(stderr, "\nWARNING: unable to play music '%s'", filename);
+        StopMusic();
+        return false;
+    }
+
+    return true;
+}
+
+void TSoundSystem::StopMusic()
+{
+    if (m_music)
+        al_destroy_audio_stream(m_music);
+
+    m_music = NULL;
+}
@@ -0,0 +1,99 @@
+#ifndef _SOUND_HPP_
+#define _SOUND_HPP_
+
+#include <atomic>
+
+#include <allegro5/allegro.h>
+#include <allegro5/allegro_audio.h>
+
+// the sound effects the game makes
+typedef enum
+{
+    eSOUND_AMMO_PICKUP,
+    eSOUND_FIRE,
+    eSOUND_DISH_HIT,
+    eSOUND_DEATH,
+
+    eSOUND_COUNT // ALWAYS LAST - is the number of sounds in the enum
+} TSound;
+
+// Short effects are loaded whole, up front, and played on a fixed set of voices. When every voice is busy
+// a new sound takes over the one with the lowest priority (the oldest, of those with the same priority),
+// unless every voice is playing something more important. Music is streamed from disk a few buffers at a
+// time rather than decoded all at once.
+//
+// The simulation only ever Post()s sounds, into a fixed-size lock-free queue, and Update() plays them once
+// a frame, so nothing that happens in a tick ever waits on the mixer.
+class TSoundSystem
+{
+public:
+    TSoundSystem();
+    ~TSoundSystem();
+
+    // Audio must already be installed, and the acodec addon initialised. Effects that won't load
+    // are only warned about, and stay silent. False if there's no way to play anything at all.
+    bool Create();
+
+    // accepts everything and plays nothing, e.g. for headless runs, or when there's no audio device
+    void CreateNull();
+
+    void Destroy();
+
+    // Never blocks. The sound is played at the next Update(), or dropped if the queue is full.
+    // Only one thread may post (the one running the simulation).
+    void Post(TSound sound);
+
+    // plays everything posted since the last call. Only from the thread that called Create().
+    void Update();
+
+    // loops filename from the start, replacing whatever music was playing
+    bool PlayMusic(const char *filename);
+    void StopMusic();
+
+    // sounds posted while the queue was full, or that every voice was too busy for
+    unsigned int Dropped() const { return m_dropped; };
+
+    enum
+    {
+        VOICES = 8,
+
+        QUEUE_SLOTS = 64, // must be a power of 2
+
+        MUSIC_BUFFERS = 4,
+        MUSIC_BUFFER_SAMPLES = 2048
+    };
+
+private:
+    typedef struct
+    {
+        ALLEGRO_SAMPLE_INSTANCE *instance;
+        signed int priority; // of what it's playing
+        unsigned int started; // when, in m_playClock ticks
+    } TVoice;
+
+    void Play(TSound sound);
+    TVoice *VoiceFor(signed int priority); // NULL if nothing playing may be interrupted
+
+    bool m_null;
+    ALLEGRO_VOICE *m_voice;
+    ALLEGRO_MIXER *m_mixer;
+    ALLEGRO_SAMPLE *m_samples[eSOUND_COUNT];
+    TVoice m_voices[VOICES];
+    unsigned int m_playClock;
+    ALLEGRO_AUDIO_STREAM *m_music;
+
+    // Written only by Post() and read only by Update(): a sound is in the queue once m_queueTail has moved
+    // past it, and its slot is free again once m_queueHead has.
+    TSound m_queue[QUEUE_SLOTS];
+    std::atomic<unsigned int> m_queueHead;
+    std::atomic<unsigned int> m_queueTail;
+
+    std::atomic<unsigned int> m_dropped;
+};
+
+namespace GLOBALS
+{
+    extern TSoundSystem sound;
+}
+
+#endif
@@ -0,0 +1,174 @@
+#include <cassert>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+
+#include "sam_shared.hpp"
+#include "spatial_grid.hpp"
+
+TSpatialGrid::TSpatialGrid() :
+        m_widthCells(0),
+        m_heightCells(0),
+        m_queryStamp(0)
+{
+}
+
+void TSpatialGrid::Reset(signed int levelWidthPixels, signed int levelHeightPixels)
+{
+    const signed int widthCells  = (levelWidthPixels  + TILE_WIDTH_PIXELS_UNSCALED  - 1) / TILE_WIDTH_PIXELS_UNSCALED;
+    const signed int heightCells = (levelHeightPixels + TILE_HEIGHT_PIXELS_UNSCALED - 1) / TILE_HEIGHT_PIXELS_UNSCALED;
+
+    // the same level again (e.g. after dying), so the cells can be kept
+    if ((widthCells == m_widthCells) && (heightCells == m_heightCells))
+    {
+        Clear();
+        return;
+    }
+
+    m_widthCells  = widthCells;
+    m_heightCells = heightCells;
+
+    m_cells.clear();
+    m_cells.resize(m_widthCells * m_heightCells);
+    m_footprints.clear();
+}
+
+void TSpatialGrid::Clear()
+{
+    // only the cells something is in, rather than every cell in the level
+    for (std::unordered_map<TInteractiveRef, TFootprint>::const_iterator it = m_footprints.begin(); it != m_footprints.end(); ++it)
+    {
+        for (signed int cellY = it->second.top; cellY <= it->second.bottom; ++cellY)
+            for (signed int cellX = it->second.left; cellX <= it->second.right; ++cellX)
+                m_cells[cellY * m_widthCells + cellX].clear();
+    }
+
+    m_footprints.clear();
+}
+
+TSpatialGrid::TFootprint TSpatialGrid::FootprintOf(signed int x, signed int y, signed int width, signed int height) const
+{
+    TFootprint footprint;
+
+    // anything hanging off the edges of the level (e.g. a bullet on its way out) is filed
+    // under the nearest edge cells
+    footprint.left   = min(max(x                 , 0), m_widthCells  * TILE_WIDTH_PIXELS_UNSCALED  - 1) / TILE_WIDTH_PIXELS_UNSCALED;
+    footprint.right  = min(max(x + width - 1     , 0), m_widthCells  * TILE_WIDTH_PIXELS_UNSCALED  - 1) / TILE_WIDTH_PIXELS_UNSCALED;
+    footprint.top    = min(max(y                 , 0), m_heightCells * TILE_HEIGHT_PIXELS_UNSCALED - 1) / TILE_HEIGHT_PIXELS_UNSCALED;
+    footprint.bottom = min(max(y + height - 1    , 0), m_heightCells * TILE_HEIGHT_PIXELS_UNSCALED - 1) / TILE_HEIGHT_PIXELS_UNSCALED;
+    footprint.stamp  = 0;
+
+    return footprint;
+}
+
+void TSpatialGrid::Link(TInteractiveRef ref, const TFootprint &footprint)
+{
+    for (signed int cellY = footprint.top; cellY <= footprint.bottom; ++cellY)
+        for (signed int cellX = footprint.left; cellX <= footprint.right; ++cellX)
+            m_cells[cellY * m_widthCells + cellX].push_back(ref);
+}
+
+void TSpatialGrid::Unlink(TInteractiveRef ref, const TFootprint &footprint)
+{
+    for (signed int cellY = footprint.top; cellY <= footprint.bottom; ++cellY)
+    {
+        for (signed int cellX = footprint.left; cellX <= footprint.right; ++cellX)
+        {
+            std::vector<TInteractiveRef> &cell = m_cells[cellY * m_widthCells + cellX];
+            std::vector<TInteractiveRef>::iterator it = std::find(cell.begin(), cell.end(), ref);
+
+            assert(it != cell.end());
+            cell.erase(it); // keep the remaining order, so iteration stays deterministic
+        }
+    }
+}
+
+void TSpatialGrid::Insert(TInteractiveRef ref, signed int x, signed int y)
+{
+    assert(m_footprints.find(ref) == m_footprints.end());
+
+    const TFootprint footprint = FootprintOf(x, y, TILE_WIDTH_PIXELS_UNSCALED, TILE_HEIGHT_PIXELS_UNSCALED);
+
+    m_footprints[ref] = footprint;
+    Link(ref, footprint);
+}
+
+void TSpatialGrid::Remove(TInteractiveRef ref)
+{
+    std::unordered_map<TInteractiveRef, TFootprint>::iterator it = m_footprints.find(ref);
+
+    assert(it != m_footprints.end());
+
+    Unlink(ref, it->second);
+    m_footprints.erase(it);
+}
+
+void TSpatialGrid::Moved(TInteractiveRef ref, signed int x, signed int y)
+{
+    std::unordered_map<TInteractiveRef, TFootprint>::iterator it = m_footprints.find(ref);
+
+    assert(it != m_footprints.end());
+
+    const TFootprint footprint = FootprintOf(x, y, TILE_WIDTH_PIXELS_UNSCALED, TILE_HEIGHT_PIXELS_UNSCALED);
+
+    // most moves stay within the same cells, and then there is nothing to do
+    if ((footprint.left  == it->second.left)  && (footprint.top    == it->second.top) &&
+        (footprint.right == it->second.right) && (footprint.bottom == it->second.bottom))
+        return;
+
+    Unlink(ref, it->second);
+    it->second = footprint;
+    Link(ref, footprint);
+}
+
+void TSpatialGrid::Rekey(TInteractiveRef from, TInteractiveRef to)
+{
+    std::unordered_map<TInteractiveRef, TFootprint>::iterator it = m_footprints.find(from);
+
+    assert(it != m_footprints.end());
+    assert(m_footprints.find(to) == m_footprints.end());
+
+    const TFootprint footprint = it->second;
+
+    for (signed int cellY = footprint.top; cellY <= footprint.bottom; ++cellY)
+    {
+        for (signed int cellX = footprint.left; cellX <= footprint.right; ++cellX)
+        {
+            std::vector<TInteractiveRef> &cell = m_cells[cellY * m_widthCells + cellX];
+            std::replace(cell.begin(), cell.end(), from, to);
+        }
+    }
+
+    m_footprints.erase(it);
+    m_footprints[to] = footprint;
+}
+
+void TSpatialGrid::Query(signed int x, signed int y, signed int width, signed int height, std::vector<TInteractiveRef> &found) const
+{
+    if (m_cells.empty())
+        return;
+
+    const TFootprint area = FootprintOf(x, y, width, height);
+
+    ++m_queryStamp;
+
+    for (signed int cellY = area.top; cellY <= area.bottom; ++cellY)
+    {
+        for (signed int cellX = area.left; cellX <= area.right; ++cellX)
+        {
+            const std::vector<TInteractiveRef> &cell = m_cells[cellY * m_widthCells + cellX];
+
+            for (std::vector<TInteractiveRef>::const_iterator it = cell.begin(); it != cell.end(); ++it)
+            {
+                const TFootprint &footprint = m_footprints.find(*it)->second;
+
+                // interactives spanning several cells would otherwise be reported once per cell
+                if (footprint.stamp != m_queryStamp)
+                {
+                    footprint.stamp = m_queryStamp;
+                    found.push_back(*it);
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,55 @@
+#ifndef _SPATIAL_GRID_HPP_
+#define _SPATIAL_GRID_HPP_
+
+#include <vector>
+#include <unordered_map>
+
+#include "sam_shared.hpp"
+
+// Uniform broadphase grid over the level, one cell per map tile. Every interactive is linked into
+// each cell its tile-sized box touches, so "what is near this spot" only has to look at a
+// handful of cells instead of every interactive in the level.
+//
+// The grid only stores references. Whoever moves an interactive has to call Moved() afterwards.
+class TSpatialGrid
+{
+public:
+    TSpatialGrid();
+
+    // size the grid to cover a level and drop everything in it
+    void Reset(signed int levelWidthPixels, signed int levelHeightPixels);
+    void Clear();
+
+    void Insert(TInteractiveRef ref, signed int x, signed int y);
+    void Remove(TInteractiveRef ref);
+    void Moved(TInteractiveRef ref, signed int x, signed int y);
+
+    // the interactive known as 'from' is now known as 'to' (e.g. it was moved within its pool)
+    void Rekey(TInteractiveRef from, TInteractiveRef to);
+
+    // Appends every interactive whose tile box shares a cell with the given rectangle (unscaled pixels)
+    // to found, each only once. These are only candidates - callers still need to do their
+    // own exact test (e.g. ObjectCollide) on the results.
+    void Query(signed int x, signed int y, signed int width, signed int height, std::vector<TInteractiveRef> &found) const;
+
+private:
+    typedef struct
+    {
+        // inclusive cell coordinates covered by the interactive
+        signed int left, top, right, bottom;
+
+        // query number that last reported this interactive, to filter duplicates
+        mutable unsigned int stamp;
+    } TFootprint;
+
+    signed int m_widthCells, m_heightCells;
+    std::vector<std::vector<TInteractiveRef> > m_cells;
+    std::unordered_map<TInteractiveRef, TFootprint> m_footprints;
+    mutable unsigned int m_queryStamp;
+
+    TFootprint FootprintOf(signed int x, signed int y, signed int width, signed int height) const;
+    void Link(TInteractiveRef ref, const TFootprint &footprint);
+    void Unlink(TInteractiveRef ref, const TFootprint &footprint);
+};
+
+#endif
@@ -0,0 +1,183 @@
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <functional>
+#include <vector>
+
+#include <allegro5/allegro.h>
+
+#include "sam_shared.hpp"
+#include "sprites.hpp"
+#include "collision.hpp"
+#include "trace.hpp"
+
+namespace GLOBALS
+{
+    TSpriteRegistry sprites;
+}
+
+enum
+{
+    // transparent pixels between packed frames, so that filtering never pulls in a neighbour
+    PACK_PADDING_PIXELS = 1
+};
+
+// the smallest rectangle holding all of a tile's non-transparent pixels
+static void TrimFrame(unsigned int tileID, TSpriteRegistry::TFrame &frame)
+{
+    const TMaskRow *mask = CollisionMaskOfTile(tileID);
+    signed int left = TILE_WIDTH_PIXELS_UNSCALED, right = -1, top = TILE_HEIGHT_PIXELS_UNSCALED, bottom = -1;
+
+    for (signed int row = 0; row < TILE_HEIGHT_PIXELS_UNSCALED; ++row)
+    {
+        if (mask[row] == 0)
+            continue;
+
+        top = min(top, row);
+        bottom = row;
+
+        for (signed int column = 0; column < TILE_WIDTH_PIXELS_UNSCALED; ++column)
+        {
+            if (mask[row] & (TMaskRow(1) << column))
+            {
+                left = min(left, column);
+                right = max(right, column);
+            }
+        }
+    }
+
+    frame.x = frame.y = 0;
+    if (bottom < 0)
+    {
+        frame.offsetX = frame.offsetY = 0;
+        frame.width = frame.height = 0;
+    }
+    else
+    {
+        frame.offsetX = left;
+        frame.offsetY = top;
+        frame.width = right - left + 1;
+        frame.height = bottom - top + 1;
+    }
+}
+
+TSpriteRegistry::TSpriteRegistry() :
+        m_atlas(NULL),
+        m_batchSize(0),
+        m_lastBatchSize(0)
+{
+}
+
+ALLEGRO_BITMAP *TSpriteRegistry::Pack(ALLEGRO_BITMAP *cellAtlas)
+{
+    assert(cellAtlas);
+
+    const signed int atlasWidth = al_get_bitmap_width(cellAtlas);
+    const unsigned int atlasWidth_tiles  = atlasWidth / TILE_WIDTH_PIXELS_UNSCALED;
+    const unsigned int atlasHeight_tiles = al_get_bitmap_height(cellAtlas) / TILE_HEIGHT_PIXELS_UNSCALED;
+    std::vector<unsigned int> order;
+    signed int shelfX = 0, shelfY = 0, shelfHeight = 0;
+    ALLEGRO_BITMAP *packed, *oldTarget;
+
+    if ((atlasWidth_tiles == 0) || (atlasHeight_tiles == 0))
+    {
+        fprintf(stderr, "\nERROR: tilesheet is smaller than a single tile");
+        return NULL;
+    }
+
+    if (CollisionMaskTileCount() != atlasWidth_tiles * atlasHeight_tiles)
+    {
+        fprintf(stderr, "\nERROR: collision masks don't match the tilesheet");
+        return NULL;
+    }
+
+    m_frames.resize(atlasWidth_tiles * atlasHeight_tiles);
+
+    // Tallest frames first, widest first among those, so that each shelf wastes as little height as it
+    // can. The sort key is height, then width, then tile ID, packed into one number.
+    for (unsigned int tileID = 0; tileID < m_frames.size(); ++tileID)
+    {
+        TrimFrame(tileID, m_frames[tileID]);
+
+        if (m_frames[tileID].width)
+            order.push_back((m_frames[tileID].height << 24) | (m_frames[tileID].width << 16) | tileID);
+    }
+
+    std::sort(order.begin(), order.end(), std::greater<unsigned int>());
+
+    // left to right along a shelf, then a new shelf below the tallest frame on this one
+    for (std::vector<unsigned int>::iterator it = order.begin(); it != order.end(); ++it)
+    {
+        TFrame &frame = m_frames[*it & 0xFFFF];
+
+        if (shelfX + frame.width > atlasWidth)
+        {
+            shelfY += shelfHeight + PACK_PADDING_PIXELS;
+            shelfX = 0;
+            shelfHeight = 0;
+        }
+
+        frame.x = shelfX;
+        frame.y = shelfY;
+
+        shelfX += frame.width + PACK_PADDING_PIXELS;
+        shelfHeight = max(shelfHeight, (signed int)frame.height);
+    }
+
+    packed = al_create_bitmap(atlasWidth, max(shelfY + shelfHeight, 1));
+    if (packed == NULL)
+    {
+        fprintf(stderr, "\nERROR: unable to create packed sprite atlas");
+        return NULL;
+    }
+
+    oldTarget = al_get_target_bitmap();
+    al_set_target_bitmap(packed);
+    al_clear_to_color(al_map_rgba(0, 0, 0, 0));
+
+    al_hold_bitmap_drawing(true);
+    for (std::vector<unsigned int>::iterator it = order.begin(); it != order.end(); ++it)
+    {
+        const unsigned int tileID = *it & 0xFFFF;
+        const TFrame &frame = m_frames[tileID];
+
+        al_draw_bitmap_region(cellAtlas,
+                              ((tileID % atlasWidth_tiles) * TILE_WIDTH_PIXELS_UNSCALED) + frame.offsetX,
+                              ((tileID / atlasWidth_tiles) * TILE_HEIGHT_PIXELS_UNSCALED) + frame.offsetY,
+                              frame.width, frame.height,
+                              frame.x, frame.y,
+                              0);
+    }
+    al_hold_bitmap_drawing(false);
+
+    al_set_target_bitmap(oldTarget);
+
+    m_atlas = packed;
+
+    TRACE_INFO("packed sprite atlas", "frames", order.size(), "height", al_get_bitmap_height(packed));
+
+    return packed;
+}
+
+void TSpriteRegistry::SetFrames(ALLEGRO_BITMAP *atlas, const std::vector<TFrame> &frames)
+{
+    assert(atlas);
+
+    m_atlas = atlas;
+    m_frames = frames;
+}
+
+void TSpriteRegistry::BeginBatch()
+{
+    assert(!al_is_bitmap_drawing_held());
+
+    m_batchSize = 0;
+    al_hold_bitmap_drawing(true);
+}
+
+void TSpriteRegistry::EndBatch()
+{
+    // releasing the hold is what actually draws everything
+    al_hold_bitmap_drawing(false);
+    m_lastBatchSize = m_batchSize;
+}
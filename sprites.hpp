@@ -0,0 +1,88 @@
+#ifndef _SPRITES_HPP_
+#define _SPRITES_HPP_
+
+#include <cassert>
+#include <vector>
+
+#include <allegro5/allegro.h>
+
+#include "sam_shared.hpp"
+
+// Where each tile is in the sprite atlas, worked out once when the atlas is loaded, and the one way
+// tiles get drawn from it. Everything drawn between BeginBatch() and EndBatch() is held back by
+// Allegro and sent to the video card together, as a single draw from the single atlas texture,
+// so the cost of a frame doesn't go up a draw call at a time with the number of sprites on screen.
+//
+// The atlas isn't the tilesheet as drawn: Pack() trims every tile down to its non-transparent pixels
+// and packs those tightly, so there's less texture to hold and no blending of empty borders. Each tile
+// keeps a frame saying where its pixels ended up and where they sit within the tile.
+class TSpriteRegistry
+{
+public:
+    typedef struct
+    {
+        unsigned short x, y;            // unscaled pixels, top left of the trimmed pixels in the atlas
+        unsigned char offsetX, offsetY; // unscaled pixels, top left of the trimmed pixels within the tile
+        unsigned char width, height;    // of the trimmed pixels. 0 for a tile with nothing to draw
+
+        // the extent of the tile's pixels, measured from the tile's top left
+        signed int Right() const { return offsetX + width; };
+        signed int Bottom() const { return offsetY + height; };
+    } TFrame;
+
+    TSpriteRegistry();
+
+    // Builds the packed atlas from a tilesheet of whole TILE_WIDTH/HEIGHT_PIXELS_UNSCALED cells, one frame
+    // per cell. Trims using the collision masks, so BuildCollisionMasks() must have been run on cellAtlas
+    // first. The registry draws from the returned bitmap; cellAtlas is no longer needed afterwards.
+    ALLEGRO_BITMAP *Pack(ALLEGRO_BITMAP *cellAtlas);
+
+    // instead of packing, e.g. when the atlas and its frames were saved together
+    void SetFrames(ALLEGRO_BITMAP *atlas, const std::vector<TFrame> &frames);
+
+    // the same atlas somewhere else, e.g. copied into video memory
+    void SetAtlas(ALLEGRO_BITMAP *atlas) { assert(atlas); m_atlas = atlas; };
+
+    unsigned int Count() const { return m_frames.size(); };
+    const TFrame &Frame(unsigned int tileID) const { assert(tileID < m_frames.size()); return m_frames[tileID]; };
+
+    // The target bitmap must not change until EndBatch(). Batches don't nest.
+    void BeginBatch();
+    void EndBatch();
+
+    // tileID with the tile's top left at x, y (unscaled pixels)
+    void Draw(unsigned int tileID, float x, float y);
+
+    // how many sprites went into the last batch
+    unsigned int LastBatchSize() const { return m_lastBatchSize; };
+
+private:
+    ALLEGRO_BITMAP *m_atlas;
+    std::vector<TFrame> m_frames; // by tile ID
+    unsigned int m_batchSize;
+    unsigned int m_lastBatchSize;
+};
+
+namespace GLOBALS
+{
+    extern TSpriteRegistry sprites;
+}
+
+inline void TSpriteRegistry::Draw(unsigned int tileID, float x, float y)
+{
+    assert(tileID < m_frames.size());
+
+    const TFrame &frame = m_frames[tileID];
+
+    // entirely transparent
+    if (frame.width == 0)
+        return;
+
+    al_draw_bitmap_region(m_atlas,
+                          frame.x, frame.y, frame.width, frame.height,
+                          x + frame.offsetX, y + frame.offsetY,
+                          0);
+    ++m_batchSize;
+}
+
+#endif
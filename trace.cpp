@@ -0,0 +1,223 @@
+#include <cstdio>
+#include <string>
+#include <atomic>
+
+#include <allegro5/allegro.h>
+
+#include <physfs.h>
+
+#include "trace.hpp"
+
+typedef struct
+{
+    const TTracePoint *point;
+    double seconds;
+    double args[2];
+    TTracePhase phase;
+    unsigned int thread;
+} TTraceRecord;
+
+// Bounded multi-producer, single-consumer ring. Each slot's sequence number says whose turn it is:
+// equal to the write position when the slot is free to be written, one more than that once the
+// record in it is ready to be read.
+enum
+{
+    RING_SLOTS = 1 << 16 // must be a power of two
+};
+
+typedef struct
+{
+    std::atomic<unsigned int> sequence;
+    TTraceRecord record;
+} TTraceSlot;
+
+static TTraceSlot s_ring[RING_SLOTS];
+static std::atomic<unsigned int> s_writePosition(0);
+static unsigned int s_readPosition = 0; // only the drain thread touches this
+
+static std::atomic<bool> s_tracing(false);
+static std::atomic<unsigned int> s_dropped(0);
+
+static PHYSFS_File *s_file = NULL;
+static ALLEGRO_THREAD *s_drainThread = NULL;
+static double s_startSeconds = 0.0;
+static bool s_firstRecord = true;
+
+// numbered as they first trace something, so each thread's spans nest on a track of their own
+static std::atomic<unsigned int> s_threadCount(0);
+static thread_local unsigned int t_thread = 0;
+
+void TraceEvent(const TTracePoint *point, TTracePhase phase, double arg0, double arg1)
+{
+    if (!s_tracing.load(std::memory_order_relaxed))
+        return;
+
+    unsigned int position = s_writePosition.load(std::memory_order_relaxed);
+    TTraceSlot *slot;
+
+    // claim a slot
+    for (;;)
+    {
+        slot = &s_ring[position & (RING_SLOTS - 1)];
+        const int lag = slot->sequence.load(std::memory_order_acquire) - position;
+
+        if (lag == 0)
+        {
+            if (s_writePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if (lag < 0)
+        {
+            // full. Losing a trace record beats stalling the game waiting for the drain thread.
+            s_dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        else
+            position = s_writePosition.load(std::memory_order_relaxed);
+    }
+
+    slot->record.point = point;
+    slot->record.seconds = al_get_time();
+    slot->record.args[0] = arg0;
+    slot->record.args[1] = arg1;
+    slot->record.phase = phase;
+
+    if (t_thread == 0)
+        t_thread = ++s_threadCount;
+    slot->record.thread = t_thread;
+
+    slot->sequence.store(position + 1, std::memory_order_release);
+}
+
+// Appends everything that is ready to json. Returns how many records there were.
+static unsigned int DrainRing(std::string &json)
+{
+    char text[256];
+    unsigned int drained = 0;
+
+    for (;;)
+    {
+        TTraceSlot *slot = &s_ring[s_readPosition & (RING_SLOTS - 1)];
+
+        if (slot->sequence.load(std::memory_order_acquire) != s_readPosition + 1)
+            break;
+
+        const TTraceRecord &record = slot->record;
+
+        snprintf(text, sizeof(text), "%s\n{\"name\": \"%s\", \"ph\": \"%c\", \"ts\": %.3f, \"pid\": 1, \"tid\": %u%s",
+                 s_firstRecord ? "" : ",",
+                 record.point->name, record.phase,
+                 (record.seconds - s_startSeconds) * 1000000.0,
+                 record.thread,
+                 (record.phase == eTRACE_INSTANT) ? ", \"s\": \"t\"" : "");
+        json += text;
+        s_firstRecord = false;
+
+        if (record.point->arg0Name)
+        {
+            if (record.point->arg1Name)
+                snprintf(text, sizeof(text), ", \"args\": {\"%s\": %g, \"%s\": %g}}",
+                         record.point->arg0Name, record.args[0], record.point->arg1Name, record.args[1]);
+            else
+                snprintf(text, sizeof(text), ", \"args\": {\"%s\": %g}}", record.point->arg0Name, record.args[0]);
+            json += text;
+        }
+        else
+            json += "}";
+
+        // hand the slot back to the writers, one lap further on
+        slot->sequence.store(s_readPosition + RING_SLOTS, std::memory_order_release);
+        ++s_readPosition;
+        ++drained;
+    }
+
+    return drained;
+}
+
+static void WriteOut(const std::string &json)
+{
+    if (!json.empty())
+        PHYSFS_write(s_file, json.data(), json.size(), 1);
+}
+
+static void *DrainThread(ALLEGRO_THREAD *thread, void __attribute__ ((unused)) *arg)
+{
+    std::string json;
+
+    while (!al_get_thread_should_stop(thread))
+    {
+        json.clear();
+
+        // nothing waiting, so have a rest rather than spin
+        if (DrainRing(json) == 0)
+            al_rest(0.005);
+        else
+            WriteOut(json);
+    }
+
+    return NULL;
+}
+
+bool StartTracing(const char *filename)
+{
+    static const char HEADER[] = "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+
+    if (s_file)
+        return true;
+
+    for (unsigned int i = 0; i < RING_SLOTS; ++i)
+        s_ring[i].sequence.store(i, std::memory_order_relaxed);
+    s_writePosition.store(0);
+    s_readPosition = 0;
+    s_dropped.store(0);
+    s_firstRecord = true;
+
+    s_file = PHYSFS_openWrite(filename);
+    if (s_file == NULL)
+    {
+        fprintf(stderr, "\nERROR: unable to create trace file '%s'. Specifically:\n\t'%s'",
+                        filename, PHYSFS_getLastError());
+        return false;
+    }
+    PHYSFS_write(s_file, HEADER, sizeof(HEADER) - 1, 1);
+
+    s_drainThread = al_create_thread(DrainThread, NULL);
+    if (s_drainThread == NULL)
+    {
+        fprintf(stderr, "\nERROR: unable to start the trace drain thread");
+        PHYSFS_close(s_file);
+        s_file = NULL;
+        return false;
+    }
+
+    s_startSeconds = al_get_time();
+    s_tracing.store(true);
+    al_start_thread(s_drainThread);
+
+    return true;
+}
+
+void StopTracing(void)
+{
+    std::string json;
+
+    if (s_file == NULL)
+        return;
+
+    s_tracing.store(false);
+
+    al_join_thread(s_drainThread, NULL);
+    al_destroy_thread(s_drainThread);
+    s_drainThread = NULL;
+
+    // whatever was written after the drain thread last looked
+    DrainRing(json);
+    json += "\n]}\n";
+    WriteOut(json);
+
+    PHYSFS_close(s_file);
+    s_file = NULL;
+
+    if (s_dropped.load())
+        fprintf(stderr, "\nWARNING: the trace buffer overflowed, %u trace events were dropped\n", s_dropped.load());
+}
@@ -0,0 +1,80 @@
+#ifndef _TRACE_HPP_
+#define _TRACE_HPP_
+
+// Structured trace logging, cheap enough to leave in the simulation.
+//
+// Trace points record a name, a timestamp and up to two numbers into a lock-free ring buffer.
+// A background thread drains the buffer into a Chrome trace JSON file (load it in chrome://tracing
+// or ui.perfetto.dev), so the game thread never waits on file or console I/O.
+//
+// Levels above SAM_TRACE_LEVEL are removed at compile time. Anything that is compiled in costs one
+// flag test until StartTracing() is called, and an unlocked buffer write after that.
+
+#define TRACE_LEVEL_NONE  0
+#define TRACE_LEVEL_ERROR 1
+#define TRACE_LEVEL_INFO  2
+#define TRACE_LEVEL_DEBUG 3 // per-tick detail
+
+#ifndef SAM_TRACE_LEVEL
+#define SAM_TRACE_LEVEL TRACE_LEVEL_INFO
+#endif
+
+// Everything about a trace point that doesn't change from one hit to the next. One of these is
+// created (statically) by each TRACE_ macro; the names must be string literals.
+typedef struct
+{
+    const char *name;
+    const char *arg0Name; // NULL if the point has no arguments
+    const char *arg1Name; // NULL if the point has less than two
+    unsigned char level;
+} TTracePoint;
+
+// Chrome trace event phases
+typedef enum
+{
+    eTRACE_INSTANT = 'i',
+    eTRACE_BEGIN   = 'B',
+    eTRACE_END     = 'E'
+} TTracePhase;
+
+// Starts writing every trace event to filename in the PhysFS write directory
+bool StartTracing(const char *filename);
+
+// writes out whatever is still buffered and closes the file. Safe to call when not tracing.
+void StopTracing(void);
+
+void TraceEvent(const TTracePoint *point, TTracePhase phase, double arg0, double arg1);
+
+#define TRACE_POINT(level, phase, name, arg0Name, arg0, arg1Name, arg1)                     \
+    do {                                                                                    \
+        static const TTracePoint tracePoint = { name, arg0Name, arg1Name, level };         \
+        TraceEvent(&tracePoint, phase, arg0, arg1);                                         \
+    } while (0)
+
+#define TRACE_NOTHING do { } while (0)
+
+#if SAM_TRACE_LEVEL >= TRACE_LEVEL_ERROR
+#define TRACE_ERROR(name, arg0Name, arg0, arg1Name, arg1) TRACE_POINT(TRACE_LEVEL_ERROR, eTRACE_INSTANT, name, arg0Name, arg0, arg1Name, arg1)
+#else
+#define TRACE_ERROR(name, arg0Name, arg0, arg1Name, arg1) TRACE_NOTHING
+#endif
+
+#if SAM_TRACE_LEVEL >= TRACE_LEVEL_INFO
+#define TRACE_INFO(name, arg0Name, arg0, arg1Name, arg1) TRACE_POINT(TRACE_LEVEL_INFO, eTRACE_INSTANT, name, arg0Name, arg0, arg1Name, arg1)
+
+// mark the start and end of something that takes time, e.g. a tick
+#define TRACE_BEGIN(name) TRACE_POINT(TRACE_LEVEL_INFO, eTRACE_BEGIN, name, NULL, 0, NULL, 0)
+#define TRACE_END(name)   TRACE_POINT(TRACE_LEVEL_INFO, eTRACE_END,   name, NULL, 0, NULL, 0)
+#else
+#define TRACE_INFO(name, arg0Name, arg0, arg1Name, arg1) TRACE_NOTHING
+#define TRACE_BEGIN(name) TRACE_NOTHING
+#define TRACE_END(name)   TRACE_NOTHING
+#endif
+
+#if SAM_TRACE_LEVEL >= TRACE_LEVEL_DEBUG
+#define TRACE_DEBUG(name, arg0Name, arg0, arg1Name, arg1) TRACE_POINT(TRACE_LEVEL_DEBUG, eTRACE_INSTANT, name, arg0Name, arg0, arg1Name, arg1)
+#else
+#define TRACE_DEBUG(name, arg0Name, arg0, arg1Name, arg1) TRACE_NOTHING
+#endif
+
+#endif